@@ -0,0 +1,208 @@
+#include "EventSystem.hpp"
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdio>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr int sEventsPerProducer = 200000;
+
+static std::atomic<long long> sReceived{ 0 };
+static std::mutex             sUserMutex; // what you'd have to wrap AddEvent() and Dispatch() in without a thread safe bus
+
+// returns millions of events per second added by all producers together, while another thread keeps dispatching
+static double RunProducers(helios::EventBusMode mode, bool userMutex, int producers)
+{
+    helios::EventSystemConfig config;
+    config.BusMode = mode;
+    helios::EventSystem::Init(config);
+
+    std::atomic<bool> done{ false };
+
+    std::thread consumer([&]()
+    {
+        while (!done.load(std::memory_order_acquire))
+        {
+            if (userMutex)
+            {
+                std::lock_guard<std::mutex> lock(sUserMutex);
+                helios::EventSystem::Dispatch();
+            }
+            else
+            {
+                helios::EventSystem::Dispatch();
+            }
+        }
+    });
+
+    auto start = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++)
+    {
+        threads.emplace_back([userMutex]()
+        {
+            for (int i = 0; i < sEventsPerProducer; i++)
+            {
+                if (userMutex)
+                {
+                    std::lock_guard<std::mutex> lock(sUserMutex);
+                    helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, i));
+                }
+                else
+                {
+                    helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, i));
+                }
+            }
+        });
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+
+    auto end = Clock::now();
+
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    helios::EventSystem::Dispatch();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return (double)producers * sEventsPerProducer / seconds / 1e6;
+}
+
+static constexpr int sBatchSize   = 256;
+static constexpr int sBatchFrames = 4000;
+
+// returns millions of events per second added and dispatched on one thread, a batch of mouse moves per frame like a platform pump would add
+static double RunBatches(helios::EventBusMode mode, bool bulk)
+{
+    helios::EventSystemConfig config;
+    config.BusMode = mode;
+    helios::EventSystem::Init(config);
+
+    std::vector<helios::MouseMoveEvent> batch;
+    for (int i = 0; i < sBatchSize; i++)
+        batch.emplace_back(i, i);
+
+    auto start = Clock::now();
+
+    for (int frame = 0; frame < sBatchFrames; frame++)
+    {
+        if (bulk)
+        {
+            helios::EventSystem::AddEvents(batch.data(), batch.size());
+        }
+        else
+        {
+            for (const helios::MouseMoveEvent& e : batch)
+                helios::EventSystem::AddEvent(e);
+        }
+
+        helios::EventSystem::Dispatch();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return (double)sBatchSize * sBatchFrames / seconds / 1e6;
+}
+
+static constexpr int sParallelListeners = 8;
+static constexpr int sParallelEvents    = 256;
+static constexpr int sParallelFrames    = 200;
+
+static std::atomic<double> sParallelSink{ 0.0 };
+
+// returns thousands of events per second dispatched to sParallelListeners independent listeners that each do a bit of math per event
+static double RunParallelDispatch(size_t workerThreads)
+{
+    helios::EventSystemConfig config;
+    config.WorkerThreads = workerThreads;
+    helios::EventSystem::Init(config);
+
+    std::vector<helios::ListenerHandle> handles;
+    for (int l = 0; l < sParallelListeners; l++)
+    {
+        handles.push_back(helios::EventSystem::SubscribeParallel<helios::MouseMoveEvent>([](const helios::MouseMoveEvent& e)
+        {
+            double x = e.GetX();
+            for (int i = 0; i < 2000; i++)
+                x = x * 0.999 + 0.5;
+
+            sParallelSink.store(x, std::memory_order_relaxed);
+        }, helios::ListenerAccess::Write(1ull << l)));
+    }
+
+    auto start = Clock::now();
+
+    for (int frame = 0; frame < sParallelFrames; frame++)
+    {
+        for (int i = 0; i < sParallelEvents; i++)
+            helios::EventSystem::AddEvent<helios::MouseMoveEvent>(i, i);
+
+        helios::EventSystem::Dispatch();
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    for (helios::ListenerHandle handle : handles)
+        helios::EventSystem::RemoveEventListener(handle);
+
+    return (double)sParallelEvents * sParallelFrames / seconds / 1e3;
+}
+
+int main()
+{
+    helios::EventSystem::AddEventListener([](const helios::IEvent&) { sReceived.fetch_add(1, std::memory_order_relaxed); });
+
+    std::printf("AddEvent() throughput with one thread dispatching (million events/s)\n");
+    std::printf("%-10s %-16s %-16s %-16s %-16s\n", "producers", "user mutex", "double buffered", "lock-free", "thread local");
+
+    for (int producers = 1; producers <= 8; producers *= 2)
+    {
+        double mutexed        = RunProducers(helios::BusMode_TypeSegregated, true,  producers);
+        double doubleBuffered = RunProducers(helios::BusMode_DoubleBuffered, false, producers);
+        double lockFree       = RunProducers(helios::BusMode_LockFree,       false, producers);
+        double threadLocal    = RunProducers(helios::BusMode_ThreadLocal,    false, producers);
+
+        std::printf("%-10d %-16.2f %-16.2f %-16.2f %-16.2f\n", producers, mutexed, doubleBuffered, lockFree, threadLocal);
+    }
+
+    std::printf("\nAddEvent() per event vs AddEvents() per batch of %d, single thread (million events/s)\n", sBatchSize);
+    std::printf("%-18s %-16s %-16s\n", "mode", "per event", "batch");
+
+    const std::pair<helios::EventBusMode, const char*> batchModes[] =
+    {
+        { helios::BusMode_TypeSegregated, "type segregated" },
+        { helios::BusMode_Variant,        "variant"         },
+        { helios::BusMode_DoubleBuffered, "double buffered" },
+        { helios::BusMode_LockFree,       "lock-free"       },
+    };
+
+    for (const auto& [mode, name] : batchModes)
+    {
+        double perEvent = RunBatches(mode, false);
+        double batched  = RunBatches(mode, true);
+
+        std::printf("%-18s %-16.2f %-16.2f\n", name, perEvent, batched);
+    }
+
+    std::printf("\nDispatch() with %d parallel listeners, by threads including the one dispatching (thousand events/s)\n", sParallelListeners);
+    std::printf("%-10s %-16s %-16s\n", "threads", "events/s", "speedup");
+
+    double serial = RunParallelDispatch(0);
+    std::printf("%-10d %-16.2f %-16.2f\n", 1, serial, 1.0);
+
+    for (size_t threads = 2; threads <= 16; threads *= 2)
+    {
+        double parallel = RunParallelDispatch(threads - 1);
+        std::printf("%-10zu %-16.2f %-16.2f\n", threads, parallel, parallel / serial);
+    }
+
+    helios::EventSystem::Init();
+
+    std::printf("dispatched %lld events\n", sReceived.load());
+    return 0;
+}
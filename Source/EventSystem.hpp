@@ -37,19 +37,45 @@
 
 #include <iostream>
 #include <string>
-#include <queue>
-#include <any>
 #include <variant>
 #include <functional>
 #include <vector>
+#include <deque>
+#include <tuple>
 #include <sstream>
+#include <memory>
+#include <new>
+#include <cstdint>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <cstring>
+#include <cstddef>
+
+// co_await NextEvent<T>() and EventTask need C++20 coroutines, everything else still works with C++17
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define HELIOS_COROUTINES 1
+#endif
+#endif
+
+// how many bytes a listener can capture before it has to be passed with EventListener::Ref()
+#ifndef HELIOS_LISTENER_CAPTURE_SIZE
+#define HELIOS_LISTENER_CAPTURE_SIZE 32
+#endif
 
 
 #define HELIOS_EVENT_CLASS_TYPE(type)\
 static ::helios::EventType GetStaticType() { return ::helios::Type_##type; }\
 virtual ::helios::EventType GetType() const override { return GetStaticType(); }
 
-#define HELIOS_EVENT_CLASS_CATEGORY(category) virtual ::helios::EventCategory GetCategory() const override { return ::helios::Category_##category; }
+#define HELIOS_EVENT_CLASS_CATEGORY(category)\
+static ::helios::EventCategory GetStaticCategory() { return ::helios::Category_##category; }\
+virtual ::helios::EventCategory GetCategory() const override { return GetStaticCategory(); }
 
 namespace helios
 {
@@ -78,6 +104,14 @@ namespace helios
         virtual EventType          GetType()     const { return Type_None;     }
         virtual EventCategory      GetCategory() const { return Category_None; }
         virtual const std::string& ToString()    const { return "";            }
+
+        // call this from a listener to stop the listeners after it from getting the event
+        // listeners only get const events, so the flag is mutable
+        void SetHandled() const { mHandled = true; }
+        bool IsHandled()  const { return mHandled; }
+
+    private:
+        mutable bool mHandled = false;
     };
 
     class WindowEvent : public IEvent
@@ -350,126 +384,3880 @@ namespace helios
 
     //
     ///////////////////////////////////////////////////////////////////////
-    // Event System Implementation
+    // Frame Arena
     ///////////////////////////////////////////////////////////////////////
     //
 
-    using EventBus       = std::queue<std::pair<std::any, EventType>>;
-    using EventListener  = std::function<void(const IEvent&)>;
-
-    class EventSystem
+    // a bump allocator that gets reset at the end of every EventSystem::Dispatch()
+    // if a frame needs more than the capacity, the rest comes from operator new, so size it with GetHighWaterMark()
+    class FrameArena
     {
     public:
-        static void Init();                            // No need to call this, just reserves capacity for the event bus
+        void Init(size_t capacity)
+        {
+            mMemory   = std::make_unique<unsigned char[]>(capacity);
+            mCapacity = capacity;
+            mUsed     = 0;
+        }
 
-        template<typename T>
-        static void AddEvent(T e);                     // Adds an event to the queue
+        void* Allocate(size_t size, size_t alignment)
+        {
+            // align the address, not the offset, the buffer itself is only aligned for max_align_t
+            void*  p     = mMemory.get() + mUsed;
+            size_t space = mCapacity - mUsed;
 
-        template<typename T>
-        static void AddCustomEvent(T e);               // Adds an event that you made :)
+            if (std::align(alignment, size, p, space))
+            {
+                mUsed = static_cast<unsigned char*>(p) - mMemory.get() + size;
+                mHighWaterMark = std::max(mHighWaterMark, mUsed + mOverflow);
+                return p;
+            }
 
-        static void AddEventListener(EventListener e); // Add an event listener to a queue
-        static void Dispatch();                        // Dispatch all events
+            mOverflow += size;
+            mHighWaterMark = std::max(mHighWaterMark, mUsed + mOverflow);
+            return ::operator new(size, std::align_val_t(alignment));
+        }
+
+        // alignment has to be the one it was allocated with
+        void Deallocate(void* p, size_t alignment)
+        {
+            if (!Contains(p))
+                ::operator delete(p, std::align_val_t(alignment));
+        }
+
+        void Reset()
+        {
+            mUsed     = 0;
+            mOverflow = 0;
+        }
+
+        bool Contains(const void* p) const
+        {
+            const unsigned char* bytes = static_cast<const unsigned char*>(p);
+            return bytes >= mMemory.get() && bytes < mMemory.get() + mCapacity;
+        }
+
+        size_t GetCapacity()      const { return mCapacity;      }
+        size_t GetUsed()          const { return mUsed;          }
+        size_t GetHighWaterMark() const { return mHighWaterMark; } // the most bytes a single frame has asked for
 
     private:
-        template<typename T>
-        static void IterateThroughEventListeners(const T& e);
+        std::unique_ptr<unsigned char[]> mMemory;
+        size_t                           mCapacity      = 0;
+        size_t                           mUsed          = 0;
+        size_t                           mOverflow      = 0;
+        size_t                           mHighWaterMark = 0;
+    };
+
+    // allocates from a FrameArena, or from the heap if it doesn't have one
+    template<typename T>
+    class ArenaAllocator
+    {
+    public:
+        using value_type                             = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap            = std::true_type;
+
+        ArenaAllocator(FrameArena* arena = nullptr) : mArena(arena) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.GetArena()) {}
+
+        T* allocate(size_t n)
+        {
+            if (mArena)
+                return static_cast<T*>(mArena->Allocate(n * sizeof(T), alignof(T)));
+
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T* p, size_t n)
+        {
+            if (mArena)
+                mArena->Deallocate(p, alignof(T));
+            else
+                std::allocator<T>().deallocate(p, n);
+        }
+
+        FrameArena* GetArena() const { return mArena; }
+
+        template<typename U> bool operator==(const ArenaAllocator<U>& other) const { return mArena == other.GetArena(); }
+        template<typename U> bool operator!=(const ArenaAllocator<U>& other) const { return mArena != other.GetArena(); }
 
     private:
-        static EventBus sEventBus;
-        static std::vector<EventListener> sEventListeners;
+        FrameArena* mArena;
     };
 
     template<typename T>
-    inline void EventSystem::AddEvent(T e)
+    using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+    // a vector in a frame arena has to let go of its memory before the arena resets
+    // sizeHint remembers how big it got so the next frame can reserve it in one go
+    template<typename T>
+    inline void ResetFrameVector(FrameVector<T>& v, size_t& sizeHint)
     {
-        static_assert(std::is_base_of<IEvent, decltype(e)>::value);
-        sEventBus.push({ e, e.GetType() });
+        if (!v.empty())
+            sizeHint = v.size();
+
+        if (v.get_allocator().GetArena())
+            v = FrameVector<T>(v.get_allocator());
+        else
+            v.clear();
+    }
+
+    template<typename T>
+    inline void ReserveFrameVector(FrameVector<T>& v, size_t sizeHint)
+    {
+        if (v.capacity() == 0 && sizeHint != 0)
+            v.reserve(sizeHint);
+    }
+
+    // makes room for count more elements with one allocation, still growing geometrically
+    template<typename T>
+    inline void GrowFrameVector(FrameVector<T>& v, size_t count)
+    {
+        if (v.size() + count > v.capacity())
+            v.reserve(std::max(v.size() + count, v.capacity() * 2));
     }
 
     //
     ///////////////////////////////////////////////////////////////////////
-    // Utility
+    // Event Storage
     ///////////////////////////////////////////////////////////////////////
     //
 
-    // helper class to use in an event listener to call functions if the event is a certain type
+    // every event type gets a small index
+    // built-in events use their EventType, custom events get the next free index the first time they're used
+    using EventTypeIndex = uint16_t;
 
-    class EventDispatcher
+    constexpr EventTypeIndex BuiltinEventTypeCount = Type_KeyType + 1;
+
+    template<typename T> struct IsBuiltinEvent                          : std::false_type {};
+    template<>           struct IsBuiltinEvent<WindowCreateEvent>       : std::true_type  {};
+    template<>           struct IsBuiltinEvent<WindowDestroyEvent>      : std::true_type  {};
+    template<>           struct IsBuiltinEvent<WindowMoveEvent>         : std::true_type  {};
+    template<>           struct IsBuiltinEvent<WindowResizeEvent>       : std::true_type  {};
+    template<>           struct IsBuiltinEvent<MouseMoveEvent>          : std::true_type  {};
+    template<>           struct IsBuiltinEvent<MouseScrollEvent>        : std::true_type  {};
+    template<>           struct IsBuiltinEvent<MouseButtonClickEvent>   : std::true_type  {};
+    template<>           struct IsBuiltinEvent<MouseButtonReleaseEvent> : std::true_type  {};
+    template<>           struct IsBuiltinEvent<KeyPressEvent>           : std::true_type  {};
+    template<>           struct IsBuiltinEvent<KeyReleaseEvent>         : std::true_type  {};
+    template<>           struct IsBuiltinEvent<KeyTypeEvent>            : std::true_type  {};
+
+    template<typename T, typename = void>
+    struct HasStaticCategory : std::false_type {};
+
+    template<typename T>
+    struct HasStaticCategory<T, std::void_t<decltype(T::GetStaticCategory())>> : std::true_type {};
+
+    // Category_None for custom events that don't use HELIOS_EVENT_CLASS_CATEGORY
+    template<typename T>
+    inline EventCategory GetStaticEventCategory()
+    {
+        if constexpr (HasStaticCategory<T>::value)
+            return T::GetStaticCategory();
+        else
+            return Category_None;
+    }
+
+    // the category of every event type index, so category subscriptions know which listener tables they belong in
+    struct EventTypeRegistry
+    {
+        std::mutex                 Mutex; // custom types can show up on any thread
+        std::vector<EventCategory> Categories =
+        {
+            Category_Window,   Category_Window,   Category_Window,      Category_Window,
+            Category_Mouse,    Category_Mouse,    Category_MouseButton, Category_MouseButton,
+            Category_Keyboard, Category_Keyboard, Category_Keyboard,
+        };
+    };
+
+    inline EventTypeRegistry& GetEventTypeRegistry()
+    {
+        static EventTypeRegistry sRegistry;
+        return sRegistry;
+    }
+
+    inline EventTypeIndex NextCustomEventTypeIndex(EventCategory category)
+    {
+        EventTypeRegistry& registry = GetEventTypeRegistry();
+        std::lock_guard<std::mutex> lock(registry.Mutex);
+
+        registry.Categories.push_back(category);
+        return static_cast<EventTypeIndex>(registry.Categories.size() - 1);
+    }
+
+    template<typename T>
+    inline EventTypeIndex GetEventTypeIndex()
+    {
+        if constexpr (IsBuiltinEvent<T>::value)
+        {
+            return static_cast<EventTypeIndex>(T::GetStaticType());
+        }
+        else
+        {
+            static const EventTypeIndex sIndex = NextCustomEventTypeIndex(GetStaticEventCategory<T>());
+            return sIndex;
+        }
+    }
+
+    // what happens when an event is added right after another event of the same type that hasn't been dispatched yet
+    enum CoalesceRule
+    {
+        Coalesce_None,      // queue both
+        Coalesce_KeepLast,  // the queued event takes the new event's value
+        Coalesce_KeepFirst, // the new event is dropped
+        Coalesce_Sum,       // MouseScrollEvent offsets are added up, any other type keeps the last value
+    };
+
+    // returns true if e was merged into pending and shouldn't be queued, e may have been moved from
+    template<typename T>
+    inline bool CoalesceInto(T& pending, T& e, CoalesceRule rule)
+    {
+        if constexpr (!std::is_move_assignable_v<T>)
+        {
+            return false;
+        }
+        else
+        {
+            switch (rule)
+            {
+                case Coalesce_KeepFirst:
+                    return true;
+
+                case Coalesce_KeepLast:
+                    pending = std::move(e);
+                    return true;
+
+                case Coalesce_Sum:
+                    if constexpr (std::is_same_v<T, MouseScrollEvent>)
+                        pending = MouseScrollEvent(pending.GetOffset() + e.GetOffset());
+                    else
+                        pending = std::move(e);
+                    return true;
+
+                default:
+                    return false;
+            }
+        }
+    }
+
+    class IEventPool
     {
     public:
-        EventDispatcher(const IEvent& e)
-            : mEvent((IEvent&)e)
+        virtual ~IEventPool() = default;
+
+        virtual void DispatchNext() = 0; // dispatches the next event in the pool, only used for custom events
+        virtual void Clear()        = 0;
+    };
+
+    // one contiguous array per event type
+    template<typename T>
+    class EventPool : public IEventPool
+    {
+    public:
+        using DispatchFn = void(*)(const T&);
+
+        EventPool(DispatchFn dispatch, FrameArena* arena) : mEvents(ArenaAllocator<T>(arena)), mDispatch(dispatch) {}
+
+        template<typename... Args>
+        void Emplace(Args&&... args)
         {
+            ReserveFrameVector(mEvents, mSizeHint);
+            mEvents.emplace_back(std::forward<Args>(args)...);
         }
 
-        // T is the type of event
-        // F gets deduced by the compiler
+        void Append(const T* events, size_t count)
+        {
+            ReserveFrameVector(mEvents, mSizeHint);
+            mEvents.insert(mEvents.end(), events, events + count);
+        }
 
-        template<typename T, typename F> 
-        void Dispatch(F& func)
+        const T& Next()                   { return mEvents[mCursor++]; }
+        T&       Back()                   { return mEvents.back();     }
+        virtual void DispatchNext() override { mDispatch(Next()); }
+
+        virtual void Clear() override
         {
-            if (mEvent.GetType() == T::GetStaticType())
-                func(*static_cast<T*>(&mEvent));
+            ResetFrameVector(mEvents, mSizeHint);
+            mCursor = 0;
         }
 
     private:
-        IEvent& mEvent;
+        FrameVector<T> mEvents;
+        size_t         mCursor   = 0;
+        size_t         mSizeHint = 0;
+        DispatchFn     mDispatch;
     };
 
-}
+    // stores every event type in its own array, plus a compact index that remembers the order they arrived in
+    // pushing is an append to two vectors, draining walks the index and each array front to back
+    class EventStorage
+    {
+    public:
+        // constructs the event right in its pool
+        template<typename T, typename... Args>
+        void Emplace(void(*dispatch)(const T&), Args&&... args)
+        {
+            EventTypeIndex index = GetEventTypeIndex<T>();
+            GetPool<T>(index, dispatch).Emplace(std::forward<Args>(args)...);
+            ReserveFrameVector(mOrder, mSizeHint);
+            mOrder.push_back(index);
+        }
 
-#ifdef HELIOS_IMPLEMENTATION
-namespace helios
-{
+        // a batch of one type grows each array at most once
+        template<typename T>
+        void Append(void(*dispatch)(const T&), const T* events, size_t count)
+        {
+            EventTypeIndex index = GetEventTypeIndex<T>();
+            GetPool<T>(index, dispatch).Append(events, count);
+            ReserveFrameVector(mOrder, mSizeHint);
+            mOrder.insert(mOrder.end(), count, index);
+        }
+
+        // only merges with the very last event, so events of other types never change order
+        template<typename T>
+        bool CoalesceWithLast(T& e, CoalesceRule rule)
+        {
+            EventTypeIndex index = GetEventTypeIndex<T>();
+
+            if (Empty() || mOrder.back() != index)
+                return false;
+
+            return CoalesceInto(static_cast<EventPool<T>&>(*mPools[index]).Back(), e, rule);
+        }
+
+        bool           Empty()    const { return mReadPos == mOrder.size(); }
+        size_t         Size()     const { return mOrder.size() - mReadPos; }
+        EventTypeIndex PeekType() const { return mOrder[mReadPos]; }
+
+        // T has to match PeekType()
+        template<typename T>
+        const T& Next()
+        {
+            return static_cast<EventPool<T>&>(*mPools[mOrder[mReadPos++]]).Next();
+        }
+
+        void DispatchNext()
+        {
+            mPools[mOrder[mReadPos++]]->DispatchNext();
+        }
+
+        FrameArena* GetArena() const { return mArena; }
+
+        void Reserve(size_t count)
+        {
+            // memory reserved from an arena now would be gone after the next reset
+            if (mArena)
+                mSizeHint = count;
+            else
+                mOrder.reserve(count);
+        }
+
+        // only call this while the storage is empty, existing pools keep their old arena
+        void SetArena(FrameArena* arena)
+        {
+            mArena = arena;
+            mOrder = FrameVector<EventTypeIndex>(ArenaAllocator<EventTypeIndex>(arena));
+        }
+
+        void Clear()
+        {
+            for (auto& pool : mPools)
+                if (pool) pool->Clear();
+
+            ResetFrameVector(mOrder, mSizeHint);
+            mReadPos = 0;
+        }
+
+    private:
+        template<typename T>
+        EventPool<T>& GetPool(EventTypeIndex index, void(*dispatch)(const T&))
+        {
+            if (index >= mPools.size())
+                mPools.resize(index + 1);
+
+            if (!mPools[index])
+                mPools[index] = std::make_unique<EventPool<T>>(dispatch, mArena);
+
+            return static_cast<EventPool<T>&>(*mPools[index]);
+        }
+
+    private:
+        std::vector<std::unique_ptr<IEventPool>> mPools;
+        FrameVector<EventTypeIndex>              mOrder;
+        size_t                                   mReadPos  = 0;
+        size_t                                   mSizeHint = 0;
+        FrameArena*                              mArena    = nullptr;
+    };
+
+    // owns a custom event on the heap (or in a frame arena) so it can sit in an EventVariant next to the built-in ones
+    class CustomEventBox
+    {
+    public:
+        using DispatchFn = void(*)(const void*);
+
+        // the event is constructed from args right in the box, so it's never copied or moved
+        template<typename T, typename... Args>
+        CustomEventBox(std::in_place_type_t<T>, DispatchFn dispatch, FrameArena* arena, Args&&... args)
+            : mEvent(new (ArenaAllocator<T>(arena).allocate(1)) T(std::forward<Args>(args)...)), mDispatch(dispatch), mArena(arena), mType(GetEventTypeIndex<T>())
+        {
+            // the exact type is known here, so IEvent doesn't need a virtual destructor
+            mDestroy = [](void* p, FrameArena* arena)
+            {
+                static_cast<T*>(p)->~T();
+                ArenaAllocator<T>(arena).deallocate(static_cast<T*>(p), 1);
+            };
+        }
+
+        CustomEventBox(CustomEventBox&& other) noexcept
+            : mEvent(other.mEvent), mDispatch(other.mDispatch), mDestroy(other.mDestroy), mArena(other.mArena), mType(other.mType)
+        {
+            other.mEvent = nullptr;
+        }
+
+        CustomEventBox& operator=(CustomEventBox&& other) noexcept
+        {
+            std::swap(mEvent,    other.mEvent);
+            std::swap(mDispatch, other.mDispatch);
+            std::swap(mDestroy,  other.mDestroy);
+            std::swap(mArena,    other.mArena);
+            std::swap(mType,     other.mType);
+            return *this;
+        }
+
+        ~CustomEventBox() { if (mEvent) mDestroy(mEvent, mArena); }
+
+        void           Dispatch()     const { mDispatch(mEvent); }
+        EventTypeIndex GetTypeIndex() const { return mType;      }
+
+        // T has to be the type the box was made with
+        template<typename T>
+        T& Get() { return *static_cast<T*>(mEvent); }
+
+    private:
+        void*          mEvent;
+        DispatchFn     mDispatch;
+        void         (*mDestroy)(void*, FrameArena*);
+        FrameArena*    mArena;
+        EventTypeIndex mType;
+    };
+
+    // the built-in events are a closed set, so they can be stored inline without any allocation
+    // they're in the same order as EventType, so index() is the EventTypeIndex
+    using BuiltinEventVariant = std::variant<
+        WindowCreateEvent, WindowDestroyEvent, WindowMoveEvent,       WindowResizeEvent,
+        MouseMoveEvent,    MouseScrollEvent,   MouseButtonClickEvent, MouseButtonReleaseEvent,
+        KeyPressEvent,     KeyReleaseEvent,    KeyTypeEvent
+    >;
 
-    EventBus                   EventSystem::sEventBus;
-    std::vector<EventListener> EventSystem::sEventListeners;
+    template<typename Variant, typename T>
+    struct AppendVariant;
 
-    void EventSystem::Init()
+    template<typename... Ts, typename T>
+    struct AppendVariant<std::variant<Ts...>, T>
     {
-        sEventListeners.reserve(69); // I don't think there will be more event listeners than this
+        using Type = std::variant<Ts..., T>;
+    };
+
+    // what the buses store, custom events go in a box at the end
+    using EventVariant = AppendVariant<BuiltinEventVariant, CustomEventBox>::Type;
+
+    inline EventTypeIndex GetEventTypeIndex(const EventVariant& e)
+    {
+        if (const CustomEventBox* box = std::get_if<CustomEventBox>(&e))
+            return box->GetTypeIndex();
 
+        return static_cast<EventTypeIndex>(e.index());
     }
 
-    void EventSystem::AddEventListener(EventListener e)
+    template<typename T>
+    inline bool CoalesceInto(EventVariant& pending, T& e, CoalesceRule rule)
     {
-        sEventListeners.push_back(e);
+        if constexpr (IsBuiltinEvent<T>::value)
+        {
+            if (T* event = std::get_if<T>(&pending))
+                return CoalesceInto(*event, e, rule);
+        }
+        else
+        {
+            CustomEventBox* box = std::get_if<CustomEventBox>(&pending);
+
+            if (box && box->GetTypeIndex() == GetEventTypeIndex<T>())
+                return CoalesceInto(box->Get<T>(), e, rule);
+        }
+
+        return false;
     }
 
-    void EventSystem::Dispatch()
+    using VariantEventBus = FrameVector<EventVariant>;
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Lock-Free Queue
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    struct MpscNode
+    {
+        std::atomic<MpscNode*> Next{ nullptr };
+    };
+
+    // intrusive multi-producer single-consumer queue (Dmitry Vyukov's design)
+    // Push() is one exchange and one store, it never waits on other producers or on the consumer
+    class MpscQueue
     {
-        for (int i = 0; i <= sEventBus.size() + 1; i++)
+    public:
+        MpscQueue() : mHead(&mStub), mTail(&mStub) {}
+
+        MpscQueue(const MpscQueue&)            = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        // any thread
+        void Push(MpscNode* node)
         {
-            auto& event = sEventBus.front();
+            PushChain(node, node);
+        }
+
+        // any thread, the nodes from first to last have to be linked through Next already
+        // the whole chain shows up at once, with the same single exchange as one node
+        void PushChain(MpscNode* first, MpscNode* last)
+        {
+            last->Next.store(nullptr, std::memory_order_relaxed);
+            MpscNode* prev = mHead.exchange(last, std::memory_order_acq_rel);
+            prev->Next.store(first, std::memory_order_release);
+        }
+
+        // consumer thread only
+        // returns nullptr when the queue is empty, or when the next node is still being pushed
+        MpscNode* Pop()
+        {
+            MpscNode* tail = mTail;
+            MpscNode* next = tail->Next.load(std::memory_order_acquire);
+
+            if (tail == &mStub)
+            {
+                if (!next)
+                    return nullptr;
 
-            switch (event.second)
+                mTail = next;
+                tail  = next;
+                next  = next->Next.load(std::memory_order_acquire);
+            }
+
+            if (next)
+            {
+                mTail = next;
+                return tail;
+            }
+
+            if (tail != mHead.load(std::memory_order_acquire))
+                return nullptr;
+
+            Push(&mStub);
+            next = tail->Next.load(std::memory_order_acquire);
+
+            if (next)
             {
-                case Type_WindowCreate:         IterateThroughEventListeners(std::any_cast<WindowCreateEvent&>      (event.first)); break;
-                case Type_WindowDestroy:        IterateThroughEventListeners(std::any_cast<WindowDestroyEvent&>     (event.first)); break;
-                case Type_WindowMove:           IterateThroughEventListeners(std::any_cast<WindowMoveEvent&>        (event.first)); break;
-                case Type_WindowResize:         IterateThroughEventListeners(std::any_cast<WindowResizeEvent&>      (event.first)); break;
-                case Type_KeyPress:             IterateThroughEventListeners(std::any_cast<KeyPressEvent&>          (event.first)); break;
-                case Type_KeyRelease:           IterateThroughEventListeners(std::any_cast<KeyReleaseEvent&>        (event.first)); break;
-                case Type_KeyType:              IterateThroughEventListeners(std::any_cast<KeyTypeEvent&>           (event.first)); break;
-                case Type_MouseScroll:          IterateThroughEventListeners(std::any_cast<MouseScrollEvent&>       (event.first)); break;
-                case Type_MouseMove:            IterateThroughEventListeners(std::any_cast<MouseMoveEvent&>         (event.first)); break;
-                case Type_MouseButtonClick:     IterateThroughEventListeners(std::any_cast<MouseButtonClickEvent&>  (event.first)); break;
-                case Type_MouseButtonRelease:   IterateThroughEventListeners(std::any_cast<MouseButtonReleaseEvent&>(event.first)); break;
-                default: __debugbreak();
+                mTail = next;
+                return tail;
             }
 
-            sEventBus.pop();
+            return nullptr;
         }
-    }
 
+    private:
+        alignas(64) std::atomic<MpscNode*> mHead; // producers
+        alignas(64) MpscNode*              mTail; // consumer
+        MpscNode                           mStub;
+    };
+
+    struct EventNode : MpscNode
+    {
+        template<typename... Args>
+        EventNode(Args&&... args) : Event(std::forward<Args>(args)...) {}
+
+        EventVariant Event;
+    };
+
+    // fixed-capacity single-producer single-consumer ring
+    // each side keeps a cached copy of the other side's index, so it only reads the shared one when it looks full or empty
     template<typename T>
-    void EventSystem::IterateThroughEventListeners(const T& e)
+    class SpscRing
     {
-        for (EventListener listener : sEventListeners)
+    public:
+        SpscRing(size_t capacity)
         {
-            listener(e);
+            size_t size = 1;
+            while (size < capacity)
+                size <<= 1;
+
+            mSlots = std::make_unique<Slot[]>(size);
+            mMask  = size - 1;
+        }
+
+        SpscRing(const SpscRing&)            = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        ~SpscRing()
+        {
+            while (Size() != 0)
+                Pop();
+        }
+
+        // producer thread only, returns false if the ring is full
+        template<typename... Args>
+        bool TryEmplace(Args&&... args)
+        {
+            size_t tail = mTail.load(std::memory_order_relaxed);
+
+            if (tail - mCachedHead > mMask)
+            {
+                mCachedHead = mHead.load(std::memory_order_acquire);
+
+                if (tail - mCachedHead > mMask)
+                    return false;
+            }
+
+            new (mSlots[tail & mMask].Storage) T(std::forward<Args>(args)...);
+            mTail.store(tail + 1, std::memory_order_release);
+            return true;
         }
+
+        // consumer thread only
+        size_t Size()  const { return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_relaxed); }
+        T&     Front()       { return *reinterpret_cast<T*>(mSlots[mHead.load(std::memory_order_relaxed) & mMask].Storage); }
+
+        void Pop()
+        {
+            size_t head = mHead.load(std::memory_order_relaxed);
+            reinterpret_cast<T*>(mSlots[head & mMask].Storage)->~T();
+            mHead.store(head + 1, std::memory_order_release);
+        }
+
+    private:
+        struct Slot
+        {
+            alignas(T) unsigned char Storage[sizeof(T)];
+        };
+
+        std::unique_ptr<Slot[]>         mSlots;
+        size_t                          mMask = 0;
+        alignas(64) std::atomic<size_t> mHead{ 0 };  // written by the consumer
+        alignas(64) std::atomic<size_t> mTail{ 0 };  // written by the producer
+        size_t                          mCachedHead = 0;
+    };
+
+    struct StampedEvent
+    {
+        template<typename... Args>
+        StampedEvent(uint64_t stamp, Args&&... args) : Stamp(stamp), Event(std::forward<Args>(args)...) {}
+
+        uint64_t     Stamp;
+        EventVariant Event;
+    };
+
+    // every thread that adds events in BusMode_ThreadLocal gets one of these
+    struct ProducerRing
+    {
+        ProducerRing(size_t capacity) : Ring(capacity) {}
+
+        SpscRing<StampedEvent>    Ring;
+        uint64_t                  LastStamp = 0;
+        std::atomic<bool>         Orphaned{ false };    // its thread has exited, Dispatch() frees it once it's drained
+
+        // only used when the ring is full, so the producer never has to wait for Dispatch()
+        std::atomic<bool>         HasOverflow{ false };
+        std::mutex                OverflowMutex;
+        std::vector<StampedEvent> Overflow;
+        std::vector<StampedEvent> DispatchOverflow;     // consumer thread only
+    };
+
+    // how far Dispatch() got in one ring or overflow list while it merges them
+    struct ProducerCursor
+    {
+        ProducerRing* Ring;
+        bool          Overflow;
+        size_t        Index;
+        size_t        Count;
+
+        StampedEvent& Front() const { return Overflow ? Ring->DispatchOverflow[Index] : Ring->Ring.Front(); }
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Bounded Bus
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    // what BusMode_Bounded does with an event when the ring is full
+    enum OverflowPolicy
+    {
+        Overflow_DropOldest,      // make room by dropping the event that has been waiting longest
+        Overflow_DropNewest,      // drop the event that's being added
+        Overflow_CoalesceByType,  // overwrite the latest queued event of the same type, drop the new one if there is none
+        Overflow_Block,           // wait for Dispatch() to make room (listeners adding events from inside Dispatch() drop the newest instead)
+    };
+
+    // a fixed-capacity ring, nothing is allocated after Init()
+    // positions are absolute and only ever grow, so a remembered position stays valid until its event is popped
+    class BoundedEventBus
+    {
+    public:
+        void Init(size_t capacity)
+        {
+            while (!Empty())
+                PopFront();
+
+            mSlots    = std::make_unique<Slot[]>(capacity);
+            mCapacity = capacity;
+            mHead     = 0;
+            mTail     = 0;
+            mLastPosition.clear();
+            mDropCounts.clear();
+        }
+
+        BoundedEventBus() = default;
+        BoundedEventBus(const BoundedEventBus&)            = delete;
+        BoundedEventBus& operator=(const BoundedEventBus&) = delete;
+
+        ~BoundedEventBus()
+        {
+            while (!Empty())
+                PopFront();
+        }
+
+        bool Empty() const { return mHead == mTail; }
+        bool Full()  const { return mTail - mHead == mCapacity; }
+
+        EventVariant& Back() { return At(mTail - 1); }
+
+        // returns false if an event was dropped or coalesced
+        bool Push(EventVariant&& e, OverflowPolicy policy)
+        {
+            EventTypeIndex type = GetEventTypeIndex(e);
+
+            if (mCapacity == 0)
+            {
+                CountDrop(type);
+                return false;
+            }
+
+            if (Full())
+            {
+                switch (policy)
+                {
+                    case Overflow_DropOldest:
+                        CountDrop(GetEventTypeIndex(At(mHead)));
+                        PopFront();
+                        break;
+
+                    case Overflow_CoalesceByType:
+                        if (type < mLastPosition.size() && mLastPosition[type] >= mHead && mLastPosition[type] < mTail && GetEventTypeIndex(At(mLastPosition[type])) == type)
+                        {
+                            At(mLastPosition[type]) = std::move(e);
+                            CountDrop(type);
+                            return false;
+                        }
+                        CountDrop(type);
+                        return false;
+
+                    case Overflow_DropNewest:
+                    case Overflow_Block:
+                        CountDrop(type);
+                        return false;
+                }
+            }
+
+            if (type >= mLastPosition.size())
+                mLastPosition.resize(type + 1, 0);
+
+            mLastPosition[type] = mTail;
+            new (mSlots[mTail % mCapacity].Storage) EventVariant(std::move(e));
+            mTail++;
+            return true;
+        }
+
+        EventVariant PopFront()
+        {
+            EventVariant& front = At(mHead);
+            EventVariant  e     = std::move(front);
+            front.~EventVariant();
+            mHead++;
+            return e;
+        }
+
+        uint64_t GetDropCount(EventTypeIndex type) const { return type < mDropCounts.size() ? mDropCounts[type] : 0; }
+
+    private:
+        struct Slot
+        {
+            alignas(EventVariant) unsigned char Storage[sizeof(EventVariant)];
+        };
+
+        EventVariant& At(size_t position) { return *reinterpret_cast<EventVariant*>(mSlots[position % mCapacity].Storage); }
+
+        void CountDrop(EventTypeIndex type)
+        {
+            if (type >= mDropCounts.size())
+                mDropCounts.resize(type + 1, 0);
+
+            mDropCounts[type]++;
+        }
+
+    private:
+        std::unique_ptr<Slot[]> mSlots;
+        size_t                  mCapacity = 0;
+        size_t                  mHead     = 0;
+        size_t                  mTail     = 0;
+        std::vector<size_t>     mLastPosition; // per type, for Overflow_CoalesceByType
+        std::vector<uint64_t>   mDropCounts;   // per type
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Timers
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    using TimerClock = std::chrono::steady_clock;
+
+    struct TimerHandle
+    {
+        uint32_t Index      = UINT32_MAX;
+        uint32_t Generation = 0;
+    };
+
+    // what a timer does when it fires, usually adding an event to the bus
+    class ITimerPayload
+    {
+    public:
+        virtual ~ITimerPayload() = default;
+
+        virtual void Fire() = 0;
+    };
+
+    // a hierarchical timing wheel, 4 levels of 64 slots
+    // level 0 holds timers expiring within 64 ticks, level 1 within 64^2 ticks and so on
+    // inserting and cancelling are O(1), and each tick only looks at one slot plus an occasional cascade from the level above
+    class TimingWheel
+    {
+    public:
+        static constexpr uint32_t SlotBits   = 6;
+        static constexpr uint32_t SlotCount  = 1 << SlotBits;
+        static constexpr uint32_t SlotMask   = SlotCount - 1;
+        static constexpr uint32_t LevelCount = 4;
+        static constexpr uint64_t MaxDelta   = (1ull << (LevelCount * SlotBits)) - 1;
+
+        TimingWheel()
+        {
+            for (auto& level : mSlots)
+                for (uint32_t& head : level)
+                    head = Nil;
+        }
+
+        uint64_t GetTick() const { return mNow; }
+
+        TimerHandle Schedule(uint64_t expiry, uint64_t period, std::unique_ptr<ITimerPayload> payload)
+        {
+            uint32_t index;
+
+            if (mFree != Nil)
+            {
+                index = mFree;
+                mFree = mNodes[index].Next;
+            }
+            else
+            {
+                index = static_cast<uint32_t>(mNodes.size());
+                mNodes.emplace_back();
+            }
+
+            Node& node   = mNodes[index];
+            node.Expiry  = std::max(expiry, mNow + 1); // the current tick has already been processed
+            node.Period  = period;
+            node.Payload = std::move(payload);
+
+            Link(index);
+            mCount++;
+
+            return { index, node.Generation };
+        }
+
+        bool Cancel(TimerHandle handle)
+        {
+            if (handle.Index >= mNodes.size() || mNodes[handle.Index].Generation != handle.Generation || !mNodes[handle.Index].Payload)
+                return false;
+
+            Unlink(handle.Index);
+            Free(handle.Index);
+            return true;
+        }
+
+        // fires every timer that expires up to and including tick now
+        void Advance(uint64_t now)
+        {
+            while (mNow < now)
+            {
+                if (mCount == 0)
+                {
+                    mNow = now;
+                    break;
+                }
+
+                mNow++;
+
+                // when a level wraps around, the next slot of the level above gets spread over the levels below
+                for (uint32_t level = 1; level < LevelCount; level++)
+                {
+                    if ((mNow & ((1ull << (level * SlotBits)) - 1)) != 0)
+                        break;
+
+                    Cascade(level, (mNow >> (level * SlotBits)) & SlotMask);
+                }
+
+                // detach the slot first, periodic timers with a short period may be linked right back into it
+                uint32_t slot  = mNow & SlotMask;
+                uint32_t index = mSlots[0][slot];
+                mSlots[0][slot] = Nil;
+
+                while (index != Nil)
+                {
+                    uint32_t next = mNodes[index].Next;
+                    mNodes[index].Payload->Fire();
+
+                    Node& node = mNodes[index];
+
+                    if (node.Period != 0)
+                    {
+                        // missed periods are skipped instead of firing all at once
+                        node.Expiry += node.Period;
+                        if (node.Expiry <= mNow)
+                            node.Expiry = mNow + node.Period;
+
+                        Link(index);
+                    }
+                    else
+                    {
+                        Free(index);
+                    }
+
+                    index = next;
+                }
+            }
+        }
+
+        // for when ticks change length, restarts the wheel at tick 0 and lets convert turn every
+        // pending timer's ticks left and period into new ticks
+        template<typename F>
+        void Retime(F&& convert)
+        {
+            for (auto& level : mSlots)
+                for (uint32_t& head : level)
+                    head = Nil;
+
+            uint64_t now = mNow;
+            mNow = 0;
+
+            for (uint32_t index = 0; index < mNodes.size(); index++)
+            {
+                Node& node = mNodes[index];
+
+                if (!node.Payload)
+                    continue;
+
+                node.Expiry = std::max<uint64_t>(convert(node.Expiry - now), 1);
+                node.Period = node.Period != 0 ? std::max<uint64_t>(convert(node.Period), 1) : 0;
+                Link(index);
+            }
+        }
+
+    private:
+        static constexpr uint32_t Nil = UINT32_MAX;
+
+        struct Node
+        {
+            uint64_t                       Expiry     = 0;
+            uint64_t                       Period     = 0;
+            std::unique_ptr<ITimerPayload> Payload;
+            uint32_t                       Prev       = Nil;
+            uint32_t                       Next       = Nil;
+            uint32_t                       Generation = 0;
+            uint16_t                       Level      = 0;
+            uint16_t                       Slot       = 0;
+        };
+
+        void Link(uint32_t index)
+        {
+            Node&    node   = mNodes[index];
+            uint64_t delta  = node.Expiry - mNow;
+            uint64_t expiry = node.Expiry;
+
+            // too far away for the wheel, it'll keep getting cascaded into the top level until it's close enough
+            if (delta > MaxDelta)
+            {
+                delta  = MaxDelta;
+                expiry = mNow + MaxDelta;
+            }
+
+            uint32_t level = 0;
+            while (level + 1 < LevelCount && delta >= (1ull << ((level + 1) * SlotBits)))
+                level++;
+
+            uint32_t  slot = (expiry >> (level * SlotBits)) & SlotMask;
+            uint32_t& head = mSlots[level][slot];
+
+            node.Level = static_cast<uint16_t>(level);
+            node.Slot  = static_cast<uint16_t>(slot);
+            node.Prev  = Nil;
+            node.Next  = head;
+
+            if (head != Nil)
+                mNodes[head].Prev = index;
+
+            head = index;
+        }
+
+        void Unlink(uint32_t index)
+        {
+            Node& node = mNodes[index];
+
+            if (node.Prev != Nil)
+                mNodes[node.Prev].Next = node.Next;
+            else
+                mSlots[node.Level][node.Slot] = node.Next;
+
+            if (node.Next != Nil)
+                mNodes[node.Next].Prev = node.Prev;
+        }
+
+        void Cascade(uint32_t level, uint32_t slot)
+        {
+            uint32_t index = mSlots[level][slot];
+            mSlots[level][slot] = Nil;
+
+            while (index != Nil)
+            {
+                uint32_t next = mNodes[index].Next;
+                Link(index);
+                index = next;
+            }
+        }
+
+        void Free(uint32_t index)
+        {
+            Node& node = mNodes[index];
+            node.Payload.reset();
+            node.Generation++;
+            node.Next = mFree;
+            mFree     = index;
+            mCount--;
+        }
+
+    private:
+        std::vector<Node> mNodes;
+        uint32_t          mSlots[LevelCount][SlotCount];
+        uint32_t          mFree  = Nil;
+        uint64_t          mNow   = 0;
+        size_t            mCount = 0;
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Delegate
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    template<typename Signature, size_t Size>
+    class InplaceDelegate;
+
+    // like std::function, but the callable is always stored inside the delegate, so it never allocates
+    // anything bigger than Size doesn't compile, keep it alive somewhere and pass Ref(callable) instead
+    template<typename R, typename... Args, size_t Size>
+    class InplaceDelegate<R(Args...), Size>
+    {
+    public:
+        InplaceDelegate() = default;
+
+        template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, InplaceDelegate>>>
+        InplaceDelegate(F&& func)
+        {
+            using Callable = std::decay_t<F>;
+
+            static_assert(sizeof(Callable)  <= Size, "the listener captures too much, pass it with Ref() or increase HELIOS_LISTENER_CAPTURE_SIZE");
+            static_assert(alignof(Callable) <= alignof(std::max_align_t));
+            static_assert(std::is_copy_constructible_v<Callable>);
+
+            new (mStorage) Callable(std::forward<F>(func));
+
+            // like std::function, a mutable lambda can still be called through a const delegate
+            mInvoke = [](const void* storage, Args... args) -> R
+            {
+                return (*static_cast<Callable*>(const_cast<void*>(storage)))(std::forward<Args>(args)...);
+            };
+
+            // function pointers and lambdas that capture pointers are copied byte by byte
+            if constexpr (!std::is_trivially_copyable_v<Callable>)
+            {
+                mManage = [](void* dst, const void* src)
+                {
+                    if (src)
+                        new (dst) Callable(*static_cast<const Callable*>(src));
+                    else
+                        static_cast<Callable*>(dst)->~Callable();
+                };
+            }
+        }
+
+        // doesn't copy func, it has to outlive the delegate
+        template<typename F>
+        static InplaceDelegate Ref(F& func)
+        {
+            return InplaceDelegate([ptr = &func](Args... args) -> R { return (*ptr)(std::forward<Args>(args)...); });
+        }
+
+        InplaceDelegate(const InplaceDelegate& other) { CopyFrom(other); }
+
+        InplaceDelegate& operator=(const InplaceDelegate& other)
+        {
+            if (this != &other)
+            {
+                Reset();
+                CopyFrom(other);
+            }
+            return *this;
+        }
+
+        ~InplaceDelegate() { Reset(); }
+
+        R operator()(Args... args) const { return mInvoke(mStorage, std::forward<Args>(args)...); }
+
+        explicit operator bool() const { return mInvoke != nullptr; }
+
+    private:
+        void CopyFrom(const InplaceDelegate& other)
+        {
+            // an empty delegate has nothing in its storage to copy
+            if (other.mManage)
+                other.mManage(mStorage, other.mStorage);
+            else if (other.mInvoke)
+                std::memcpy(mStorage, other.mStorage, Size);
+
+            mInvoke = other.mInvoke;
+            mManage = other.mManage;
+        }
+
+        void Reset()
+        {
+            if (mManage)
+                mManage(mStorage, nullptr);
+
+            mInvoke = nullptr;
+            mManage = nullptr;
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char mStorage[Size] = {}; // zeroed, a small callable is still copied as Size bytes
+        R    (*mInvoke)(const void*, Args...) = nullptr;
+        void (*mManage)(void*, const void*)   = nullptr; // copies src into dst, or destroys dst when src is null
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Job System
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    // a Chase-Lev deque of pointers, the thread that owns it pushes and pops at the bottom and any other thread can steal from the top
+    // it never grows, the job system only needs a few slots per thread
+    template<typename T, size_t Capacity>
+    class WorkStealingDeque
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+    public:
+        // owner only, false when it's full
+        bool Push(T* item)
+        {
+            int64_t bottom = mBottom.load(std::memory_order_relaxed);
+            int64_t top    = mTop.load(std::memory_order_acquire);
+
+            if (bottom - top >= static_cast<int64_t>(Capacity))
+                return false;
+
+            mItems[bottom & (Capacity - 1)].store(item, std::memory_order_relaxed);
+            mBottom.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        // owner only, the newest item
+        T* Pop()
+        {
+            int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+            mBottom.store(bottom, std::memory_order_seq_cst);
+            int64_t top = mTop.load(std::memory_order_seq_cst);
+
+            if (top > bottom)
+            {
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            T* item = mItems[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+
+            // the last one, a thief could be taking it right now
+            if (top == bottom)
+            {
+                if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    item = nullptr;
+
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+
+            return item;
+        }
+
+        // any thread, the oldest item, nullptr when it's empty or another thread got there first
+        T* Steal()
+        {
+            int64_t top    = mTop.load(std::memory_order_seq_cst);
+            int64_t bottom = mBottom.load(std::memory_order_seq_cst);
+
+            if (top >= bottom)
+                return nullptr;
+
+            T* item = mItems[top & (Capacity - 1)].load(std::memory_order_relaxed);
+
+            if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+
+            return item;
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> mTop    { 0 };
+        alignas(64) std::atomic<int64_t> mBottom { 0 };
+        std::atomic<T*>                  mItems[Capacity] = {};
+    };
+
+    // runs a parallel for on a few threads that steal work from each other
+    // a range of jobs is cut in half until it's one job, the thread keeps the lower half and pushes the upper one to its deque for the others to steal
+    // that keeps every deque at a few ranges, and the big ranges are the ones that get stolen
+    class JobSystem
+    {
+    public:
+        using Job = void (*)(void* context, size_t index);
+
+        JobSystem() = default;
+        JobSystem(const JobSystem&)            = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        ~JobSystem() { Stop(); }
+
+        void Start(size_t threads)
+        {
+            Stop();
+
+            mStopping = false;
+            mQueues   = std::make_unique<JobQueue[]>(threads + 1); // the thread calling Run() is worker 0
+            mWorkers  = threads + 1;
+
+            for (size_t worker = 1; worker <= threads; worker++)
+                mThreads.emplace_back([this, worker] { WorkerLoop(worker); });
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopping = true;
+            }
+
+            mWake.notify_all();
+
+            for (std::thread& thread : mThreads)
+                thread.join();
+
+            mThreads.clear();
+            mQueues.reset();
+            mWorkers = 0;
+        }
+
+        size_t GetThreadCount() const { return mThreads.size(); }
+
+        // calls job(context, i) for every i below count, one thread calls it at a time
+        void Run(size_t count, Job job, void* context)
+        {
+            if (mThreads.empty() || count < 2)
+            {
+                for (size_t i = 0; i < count; i++)
+                    job(context, i);
+
+                return;
+            }
+
+            // cutting a range in half adds one range, so there are never more ranges than jobs
+            if (mRanges.size() < count)
+                mRanges.resize(count);
+
+            mJob     = job;
+            mContext = context;
+            mRanges[0] = { 0, count };
+            mNextRange.store(1, std::memory_order_relaxed);
+            mPending.store(count, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mRunning.store(true, std::memory_order_relaxed);
+                mRound++;
+            }
+
+            mWake.notify_all();
+
+            Execute(&mRanges[0], 0);
+
+            while (mPending.load(std::memory_order_acquire) != 0)
+            {
+                if (JobRange* range = FindWork(0))
+                    Execute(range, 0);
+                else
+                    std::this_thread::yield();
+            }
+
+            mRunning.store(false, std::memory_order_relaxed);
+        }
+
+    private:
+        struct JobRange
+        {
+            size_t Begin;
+            size_t End;
+        };
+
+        using JobQueue = WorkStealingDeque<JobRange, 64>;
+
+        void WorkerLoop(size_t worker)
+        {
+            uint64_t seen = 0;
+
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mMutex);
+                    mWake.wait(lock, [&] { return mStopping || mRound != seen; });
+
+                    if (mStopping)
+                        return;
+
+                    seen = mRound;
+                }
+
+                // jobs are short, so it keeps looking until the round is over instead of going back to sleep
+                while (mRunning.load(std::memory_order_acquire))
+                {
+                    if (JobRange* range = FindWork(worker))
+                        Execute(range, worker);
+                    else
+                        std::this_thread::yield();
+                }
+            }
+        }
+
+        JobRange* FindWork(size_t worker)
+        {
+            if (JobRange* range = mQueues[worker].Pop())
+                return range;
+
+            for (size_t i = 1; i < mWorkers; i++)
+                if (JobRange* range = mQueues[(worker + i) % mWorkers].Steal())
+                    return range;
+
+            return nullptr;
+        }
+
+        void Execute(JobRange* range, size_t worker)
+        {
+            while (range->End - range->Begin > 1)
+            {
+                size_t    middle = range->Begin + (range->End - range->Begin) / 2;
+                JobRange* upper  = &mRanges[mNextRange.fetch_add(1, std::memory_order_relaxed)];
+
+                upper->Begin = middle;
+                upper->End   = range->End;
+                range->End   = middle;
+
+                // can't happen with 64 slots, but the upper half still has to run
+                if (!mQueues[worker].Push(upper))
+                    Execute(upper, worker);
+            }
+
+            mJob(mContext, range->Begin);
+            mPending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+
+        std::vector<std::thread>    mThreads;
+        std::unique_ptr<JobQueue[]> mQueues;
+        size_t                      mWorkers   = 0;
+        std::vector<JobRange>       mRanges;
+        std::atomic<size_t>         mNextRange { 0 };
+        std::atomic<size_t>         mPending   { 0 };
+        std::atomic<bool>           mRunning   { false };
+        Job                         mJob       = nullptr;
+        void*                       mContext   = nullptr;
+        std::mutex                  mMutex;
+        std::condition_variable     mWake;
+        bool                        mStopping  = false;
+        uint64_t                    mRound     = 0;
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Executors
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    // where a listener added with EventSystem::SubscribeOn() is called
+    enum ListenerExecutor
+    {
+        Executor_Inline,     // on the thread calling Dispatch(), like any other listener
+        Executor_MainThread, // on whatever thread calls EventSystem::PumpMainThread(), like the render thread
+        Executor_Worker,     // on one of the EventSystemConfig::ExecutorThreads background threads, always the same one
+        Executor_Dedicated,  // on a thread of its own
+    };
+
+    // an event copied for a listener that runs on another thread
+    struct ListenerMail : public MpscNode
+    {
+        virtual ~ListenerMail() = default;
+        virtual void Deliver() = 0;
+    };
+
+    // the mail for a few listeners, posting is a push to a lock-free queue
+    class MailQueue
+    {
+    public:
+        MailQueue() = default;
+        MailQueue(const MailQueue&)            = delete;
+        MailQueue& operator=(const MailQueue&) = delete;
+
+        virtual ~MailQueue() = default;
+
+        // any thread
+        virtual void Post(ListenerMail* mail)
+        {
+            mPending.fetch_add(1, std::memory_order_seq_cst);
+            mQueue.Push(mail);
+        }
+
+        bool HasMail() const { return mPending.load(std::memory_order_seq_cst) != 0; }
+
+        // one thread at a time, returns how many were delivered
+        size_t Drain()
+        {
+            size_t delivered = 0;
+
+            while (MpscNode* node = mQueue.Pop())
+            {
+                ListenerMail* mail = static_cast<ListenerMail*>(node);
+                mail->Deliver();
+                delete mail;
+
+                mPending.fetch_sub(1, std::memory_order_relaxed);
+                delivered++;
+            }
+
+            return delivered;
+        }
+
+    private:
+        MpscQueue           mQueue;
+        std::atomic<size_t> mPending { 0 }; // counted before the push, so it's never 0 while a post is on its way
+    };
+
+    // a thread that delivers the mail posted to it, it sleeps when there is none
+    // posting only takes the mutex to wake it up
+    class ExecutorThread : public MailQueue
+    {
+    public:
+        ExecutorThread() : mThread([this] { Run(); mFinished.store(true, std::memory_order_release); }) {}
+
+        // delivers what's already posted first
+        ~ExecutorThread()
+        {
+            Stop();
+            mThread.join();
+        }
+
+        // doesn't wait, the thread stops once it has delivered what's already posted
+        // so it's fine to call from the executor's own thread, delete it when IsFinished()
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopping = true;
+            }
+
+            mWake.notify_one();
+        }
+
+        bool IsFinished() const { return mFinished.load(std::memory_order_acquire); }
+
+        virtual void Post(ListenerMail* mail) override
+        {
+            MailQueue::Post(mail);
+
+            if (mSleeping.load(std::memory_order_seq_cst))
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mWake.notify_one();
+            }
+        }
+
+    private:
+        void Run()
+        {
+            while (true)
+            {
+                if (Drain() != 0)
+                    continue;
+
+                std::unique_lock<std::mutex> lock(mMutex);
+
+                // a post either counted itself before this check, or sees mSleeping and wakes us up
+                mSleeping.store(true, std::memory_order_seq_cst);
+
+                if (!HasMail())
+                {
+                    if (mStopping)
+                        return;
+
+                    mWake.wait(lock);
+                }
+
+                mSleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        std::mutex              mMutex;
+        std::condition_variable mWake;
+        std::atomic<bool>       mSleeping { false };
+        bool                    mStopping = false;
+        std::atomic<bool>       mFinished { false };
+        std::thread             mThread;            // last, so everything it uses is there before it starts
+    };
+
+    // a listener's function, shared by the poster in the listener tables and its mail that hasn't been delivered yet
+    template<typename T, typename F>
+    class ListenerMailbox
+    {
+    public:
+        explicit ListenerMailbox(F func) : mFunc(std::move(func)) {}
+
+        void AddRef()  { mRefs.fetch_add(1, std::memory_order_relaxed); }
+        void Release() { if (mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this; }
+
+        void Call(const T& e) { mFunc(e); }
+
+    private:
+        F                   mFunc;
+        std::atomic<size_t> mRefs { 1 };
+    };
+
+    template<typename T, typename F>
+    struct EventMail : public ListenerMail
+    {
+        EventMail(ListenerMailbox<T, F>* box, const T& e) : Box(box), Event(e) { Box->AddRef(); }
+        ~EventMail() override { Box->Release(); }
+
+        virtual void Deliver() override { Box->Call(Event); }
+
+        ListenerMailbox<T, F>* Box;
+        T                      Event;
+    };
+
+    // what sits in the listener tables for a listener on another thread, it copies the event into a mail for it
+    template<typename T, typename F>
+    class MailPoster
+    {
+    public:
+        MailPoster(ListenerMailbox<T, F>* box, MailQueue* queue) : mBox(box), mQueue(queue) {}
+        MailPoster(const MailPoster& other) : mBox(other.mBox), mQueue(other.mQueue) { mBox->AddRef(); }
+        MailPoster& operator=(const MailPoster&) = delete;
+
+        ~MailPoster() { mBox->Release(); }
+
+        void operator()(const IEvent& e) const { mQueue->Post(new EventMail<T, F>(mBox, static_cast<const T&>(e))); }
+
+    private:
+        ListenerMailbox<T, F>* mBox;
+        MailQueue*             mQueue;
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Event System Implementation
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    using EventBus       = EventStorage;
+    using EventListener  = InplaceDelegate<void(const IEvent&), HELIOS_LISTENER_CAPTURE_SIZE>;
+
+    enum KeyModifier
+    {
+        Modifier_None    = 0,
+        Modifier_Control = 1 << 0,
+        Modifier_Shift   = 1 << 1,
+        Modifier_Alt     = 1 << 2,
+        Modifier_Any     = 1 << 3, // SubscribeKey() doesn't care which modifiers are held
+    };
+
+    // the key (or button, or character) SubscribeKey() looks at, only these event types can be subscribed to by key
+    inline int GetEventKey(const KeyPressEvent& e)    { return e.GetKey();    }
+    inline int GetEventKey(const KeyReleaseEvent& e)  { return e.GetKey();    }
+    inline int GetEventKey(const KeyTypeEvent& e)     { return e.GetChar();   }
+    inline int GetEventKey(const MouseButtonEvent& e) { return e.GetButton(); }
+
+    template<typename T, typename = void>
+    struct IsKeyedEvent : std::false_type {};
+
+    template<typename T>
+    struct IsKeyedEvent<T, std::void_t<decltype(GetEventKey(std::declval<const T&>()))>> : std::true_type {};
+
+    inline int GetEventModifiers(const KeyTypeEvent&) { return Modifier_None; }
+
+    template<typename T>
+    inline int GetEventModifiers(const T& e)
+    {
+        return (e.IsControl() ? Modifier_Control : 0) | (e.IsShift() ? Modifier_Shift : 0) | (e.IsAlt() ? Modifier_Alt : 0);
+    }
+
+    // open addressing with linear probing, maps 64-bit keys to small indices in one flat array
+    // nothing is ever erased, so a lookup only stops at the key or an empty entry
+    class FlatIndexMap
+    {
+    public:
+        static constexpr uint32_t NotFound = UINT32_MAX;
+
+        bool Empty() const { return mCount == 0; }
+
+        uint32_t Find(uint64_t key) const
+        {
+            if (mCount == 0)
+                return NotFound;
+
+            for (size_t i = Hash(key) & mMask; ; i = (i + 1) & mMask)
+            {
+                if (mEntries[i].Key == key)
+                    return mEntries[i].Value;
+
+                if (mEntries[i].Key == EmptyKey)
+                    return NotFound;
+            }
+        }
+
+        // key can't be in the map already
+        void Insert(uint64_t key, uint32_t value)
+        {
+            // stays at most half full, so probes are short
+            if ((mCount + 1) * 2 > mEntries.size())
+            {
+                std::vector<Entry> old = std::move(mEntries);
+                mEntries.assign(std::max<size_t>(16, old.size() * 2), Entry());
+                mMask = mEntries.size() - 1;
+
+                for (const Entry& entry : old)
+                    if (entry.Key != EmptyKey)
+                        Place(entry);
+            }
+
+            Place({ key, value });
+            mCount++;
+        }
+
+    private:
+        static constexpr uint64_t EmptyKey = UINT64_MAX;
+
+        struct Entry
+        {
+            uint64_t Key   = EmptyKey;
+            uint32_t Value = 0;
+        };
+
+        static size_t Hash(uint64_t key)
+        {
+            key ^= key >> 33;
+            key *= 0xff51afd7ed558ccdULL;
+            key ^= key >> 33;
+            return static_cast<size_t>(key);
+        }
+
+        void Place(const Entry& entry)
+        {
+            size_t i = Hash(entry.Key) & mMask;
+
+            while (mEntries[i].Key != EmptyKey)
+                i = (i + 1) & mMask;
+
+            mEntries[i] = entry;
+        }
+
+    private:
+        std::vector<Entry> mEntries;
+        size_t             mMask  = 0;
+        size_t             mCount = 0;
+    };
+
+    // a view of events of one type, what batch listeners get
+    // the names match std::span, so it works with range for loops and the standard algorithms
+    template<typename T>
+    class EventSpan
+    {
+    public:
+        EventSpan(const T* data, size_t size) : mData(data), mSize(size) {}
+
+        const T* begin() const { return mData;         }
+        const T* end()   const { return mData + mSize; }
+        const T* data()  const { return mData;         }
+        size_t   size()  const { return mSize;         }
+        bool     empty() const { return mSize == 0;    }
+
+        const T& operator[](size_t i) const { return mData[i]; }
+
+    private:
+        const T* mData;
+        size_t   mSize;
+    };
+
+    // the events of one type dispatched during a Dispatch(), collected for batch listeners
+    class IEventBatchBuffer
+    {
+    public:
+        virtual ~IEventBatchBuffer() = default;
+
+        virtual const void* Data()  const = 0;
+        virtual size_t      Size()  const = 0;
+        virtual void        Clear()       = 0; // keeps the memory for the next Dispatch()
+    };
+
+    template<typename T>
+    class EventBatchBuffer : public IEventBatchBuffer
+    {
+    public:
+        void Add(const T& e) { mEvents.push_back(e); }
+
+        virtual const void* Data()  const override { return mEvents.data(); }
+        virtual size_t      Size()  const override { return mEvents.size(); }
+        virtual void        Clear()       override { mEvents.clear();       }
+
+    private:
+        std::vector<T> mEvents;
+    };
+
+    // what a batch listener's EventListener is called with, it turns it back into an EventSpan
+    struct EventBatch : public IEvent
+    {
+        const void* Data = nullptr;
+        size_t      Size = 0;
+    };
+
+    // what a parallel listener touches, the bits mean whatever you want them to (physics, audio, analytics...)
+    // listeners that write a bit another one reads or writes don't run at the same time, the one with the higher priority goes first
+    struct ListenerAccess
+    {
+        uint64_t Reads  = 0;
+        uint64_t Writes = 0;
+
+        static ListenerAccess Read(uint64_t bits)  { return { bits, 0 }; }
+        static ListenerAccess Write(uint64_t bits) { return { 0, bits }; }
+        static ListenerAccess Exclusive()          { return { 0, UINT64_MAX }; } // never runs next to another parallel listener
+
+        bool IsExclusive() const { return Writes == UINT64_MAX; }
+
+        bool ConflictsWith(const ListenerAccess& other) const
+        {
+            return IsExclusive() || other.IsExclusive() || (Writes & (other.Reads | other.Writes)) != 0 || (other.Writes & Reads) != 0;
+        }
+    };
+
+    enum ListenerKind
+    {
+        Listener_Serial,   // called on the thread calling Dispatch(), one event at a time
+        Listener_Batch,    // added with SubscribeBatch(), it gets an EventBatch
+        Listener_Parallel, // added with AddParallelListener() or SubscribeParallel(), it runs on the job system
+    };
+
+    // an event dispatched to the parallel listeners, they go through the events of a batch after the serial listeners are done with them
+    struct ParallelEvent
+    {
+        const IEvent*  Event;
+        EventTypeIndex Type;
+        EventCategory  Category;
+    };
+
+    // a coroutine suspended in co_await NextEvent<T>(), linked into the wait list for T
+    // every list has a head that points at itself when it's empty, so a waiter can unlink itself from whatever list it's in
+    // the coroutine handle is stored as an address, so EventSystem looks the same to C++17 and C++20 translation units
+    struct EventWaiter
+    {
+        EventWaiter*  Prev   = nullptr;
+        EventWaiter*  Next   = nullptr;
+        void*         Handle = nullptr;                 // std::coroutine_handle<>::address()
+        void        (*Resume)(void* handle) = nullptr;  // resumes Handle, set by the C++20 code that suspended it
+        const IEvent* Event  = nullptr;                 // set right before the coroutine is resumed
+
+        void Unlink()
+        {
+            if (!Next)
+                return;
+
+            Prev->Next = Next;
+            Next->Prev = Prev;
+            Prev       = nullptr;
+            Next       = nullptr;
+        }
+    };
+
+    template<typename T>
+    class NextEventAwaiter;
+
+    // you get one of these when you add a listener, so you can remove it again
+    struct ListenerHandle
+    {
+        uint32_t Index      = UINT32_MAX;
+        uint32_t Generation = 0;
+    };
+
+    // where a listener lives, the listener tables only point at these
+    struct ListenerSlot
+    {
+        static constexpr EventTypeIndex AnyType = UINT16_MAX;
+        static constexpr uint64_t       NoKey   = UINT64_MAX;
+
+        EventListener  Listener;
+        EventTypeIndex Type         = AnyType; // AnyType for listeners added with AddEventListener() or SubscribeCategory()
+        int            CategoryMask = 0;       // only used when Type is AnyType, 0 means every event
+        uint64_t       Key          = NoKey;   // the type, key and modifiers for listeners added with SubscribeKey()
+        int            Priority     = 0;
+        uint32_t       Generation   = 0;       // goes up when the listener is removed, so old handles stop working
+        std::atomic<bool> Alive     { false };  // cleared as soon as it's removed, a Dispatch() that can still see it skips it from then on
+        ListenerKind   Kind         = Listener_Serial;
+        ListenerAccess Access;                 // only used by parallel listeners
+
+        bool Wants(EventCategory category) const { return CategoryMask == 0 || (category != Category_None && (category & CategoryMask) != 0); }
+    };
+
+    enum EventBusMode
+    {
+        BusMode_TypeSegregated, // one array per event type, the default
+        BusMode_Variant,        // one array of EventVariant, dispatched with std::visit
+        BusMode_DoubleBuffered, // AddEvent() can be called from any thread, Dispatch() swaps buffers and drains the old one
+        BusMode_LockFree,       // AddEvent() can be called from any thread, events are pushed to a lock-free queue (one allocation each, the frame arena isn't used)
+        BusMode_ThreadLocal,    // AddEvent() can be called from any thread, each thread has its own ring and Dispatch() merges them by time stamp
+        BusMode_Bounded,        // AddEvent() can be called from any thread, a fixed-capacity ring with an OverflowPolicy
+    };
+
+    // BusMode_TypeSegregated and BusMode_DoubleBuffered keep one bus per priority and dispatch the higher ones first
+    enum EventPriority
+    {
+        Priority_High,
+        Priority_Normal,
+        Priority_Low,
+
+        Priority_Count
+    };
+
+    // true if the last argument is an EventPriority, so AddEvent<T>(args..., priority) isn't taken as constructor arguments
+    template<typename... Args>
+    struct IsEmplacePriority : std::false_type {};
+
+    template<typename Last>
+    struct IsEmplacePriority<Last> : std::is_same<std::decay_t<Last>, EventPriority> {};
+
+    template<typename First, typename... Rest>
+    struct IsEmplacePriority<First, Rest...> : IsEmplacePriority<Rest...> {};
+
+    struct EventSystemConfig
+    {
+        EventBusMode         BusMode         = BusMode_TypeSegregated;
+        size_t               ReserveEvents   = 1024;
+        size_t               FrameArenaSize  = 0;                            // bytes, if not 0 queued events live in a FrameArena that's reset after every Dispatch()
+        size_t               ThreadRingSize  = 4096;                         // events per thread in BusMode_ThreadLocal, rounded up to a power of two
+        size_t               BoundedCapacity = 4096;                         // events in BusMode_Bounded, at least 1
+        OverflowPolicy       Overflow        = Overflow_DropOldest;          // what BusMode_Bounded does when it's full
+        size_t               PriorityBurst   = 0;                            // if not 0, after this many events in a row from higher priorities one lower priority event is dispatched
+        size_t               WorkerThreads   = 0;                            // threads for the parallel listeners besides the one calling Dispatch(), 0 runs them all on that one
+        size_t               ExecutorThreads = 1;                            // background threads shared by the listeners added with Executor_Worker, started with the first one
+        TimerClock::duration TimerResolution = std::chrono::milliseconds(1); // how precise AddEventAfter() and AddEventAt() are, at least one tick of TimerClock
+    };
+
+    // shared between versions of the registry until one of them changes it
+    using SharedListeners = std::shared_ptr<std::vector<ListenerSlot*>>;
+
+    // the parallel listeners and the waves they run in, rebuilt together
+    struct ParallelSchedule
+    {
+        std::vector<ListenerSlot*>              Listeners;
+        std::vector<std::vector<ListenerSlot*>> Waves;     // listeners in a wave don't conflict, the waves run one after the other
+    };
+
+    // everything Dispatch() reads to find listeners, a version never changes once it's published
+    // adding or removing a listener copies the latest version, changes the copy and publishes that (read-copy-update)
+    // the copy only points at the same lists, a list is copied when a listener is added to it or removed from it
+    struct ListenerRegistry
+    {
+        SharedListeners                   EventListeners = std::make_shared<std::vector<ListenerSlot*>>(); // the ones added with AddEventListener() and SubscribeCategory()
+        std::vector<SharedListeners>      Tables;                  // indexed by EventTypeIndex, only the listeners that want that type
+        FlatIndexMap                      KeyedListeners;          // MakeListenerKey() to an index in KeyedLists
+        std::vector<SharedListeners>      KeyedLists;
+        std::vector<std::shared_ptr<IEventBatchBuffer>> BatchBuffers; // indexed by EventTypeIndex, only types with batch listeners have one
+        std::vector<SharedListeners>      BatchLists;              // indexed by EventTypeIndex, null for types without batch listeners
+        std::shared_ptr<ParallelSchedule> Parallel = std::make_shared<ParallelSchedule>();
+    };
+
+    // a version of the registry that was replaced, and the slot of the listener that was removed by it
+    // both are freed once no Dispatch() can be looking at them anymore
+    struct RetiredListeners
+    {
+        static constexpr uint32_t NoSlot = UINT32_MAX;
+
+        uint64_t          Epoch;
+        ListenerRegistry* Registry;
+        uint32_t          Slot;
+    };
+
+    // the parts of a listener that only some kinds need
+    struct ListenerOptions
+    {
+        uint64_t                           Key  = ListenerSlot::NoKey;
+        ListenerKind                       Kind = Listener_Serial;
+        ListenerAccess                     Access;
+        std::shared_ptr<IEventBatchBuffer> BatchBuffer; // batch listeners, used if their type doesn't have one yet
+        std::unique_ptr<ExecutorThread>    Executor;    // Executor_Dedicated listeners, stopped when the slot is freed
+    };
+
+    using ExecutorList = std::vector<std::unique_ptr<ExecutorThread>>;
+
+    class EventSystem
+    {
+    public:
+        static void Init(const EventSystemConfig& config = {}); // No need to call this unless you want a different config, call it before adding events
+
+        template<typename T>
+        static void AddEvent(T e);                     // Adds an event to the queue
+
+        template<typename T>
+        static void AddEvent(T e, EventPriority priority); // Adds an event with a different priority than the one set for its type
+
+        // Constructs the event right in the queue, like AddEvent<KeyPressEvent>(key), so it's never copied
+        template<typename T, typename... Args, typename = std::enable_if_t<!IsEmplacePriority<Args...>::value>>
+        static void AddEvent(Args&&... args);
+
+        template<typename T, typename... Args>
+        static void AddEventWithPriority(EventPriority priority, Args&&... args); // Same thing with a priority
+
+        template<typename T>
+        static void AddCustomEvent(T e);               // Adds an event that you made :) Move-only events are fine
+
+        template<typename T>
+        static void AddCustomEvent(T e, EventPriority priority);
+
+        template<typename T, typename... Args, typename = std::enable_if_t<!IsEmplacePriority<Args...>::value>>
+        static void AddCustomEvent(Args&&... args);
+
+        template<typename T, typename... Args>
+        static void AddCustomEventWithPriority(EventPriority priority, Args&&... args);
+
+        // Adds a batch of events in the order they're in, with one reservation (and one lock in the thread safe modes) for the whole batch
+        template<typename T>
+        static void AddEvents(const T* events, size_t count);
+
+        static void AddEvents(const BuiltinEventVariant* events, size_t count); // For batches of different event types
+
+        template<typename T>
+        static void AddCustomEvents(const T* events, size_t count);
+
+        // Adds an event (yours or a built-in one) at the start of the first Dispatch() after the delay or time point
+        // If period isn't zero, it's added again every period until you cancel it
+        template<typename T>
+        static TimerHandle AddEventAfter(T e, TimerClock::duration delay, TimerClock::duration period = TimerClock::duration::zero());
+
+        template<typename T>
+        static TimerHandle AddEventAt(T e, TimerClock::time_point time, TimerClock::duration period = TimerClock::duration::zero());
+
+        static bool CancelTimer(TimerHandle handle);   // Returns false if the timer has already fired or been cancelled
+
+        // Listeners with a higher priority get events first, and can stop the rest from getting them with IEvent::SetHandled()
+        // Listeners with the same priority get events in the order they were added
+        static ListenerHandle AddEventListener(EventListener e, int priority = 0); // Add an event listener to a queue
+
+        // Only calls func for events of type T, like Subscribe<KeyPressEvent>([](const KeyPressEvent& e) {})
+        // Works for your own events too, and func doesn't need an EventDispatcher
+        template<typename T, typename F>
+        static ListenerHandle Subscribe(F&& func, int priority = 0);
+
+        // Only calls listener for events in one of the categories, like SubscribeCategory(Category_Keyboard | Category_MouseButton, listener)
+        // Your own events need HELIOS_EVENT_CLASS_CATEGORY to be part of a category
+        static ListenerHandle SubscribeCategory(int categoryMask, EventListener listener, int priority = 0);
+
+        // Only calls func for one key or mouse button of T, like SubscribeKey<KeyPressEvent>('S', func, Modifier_Control)
+        // With Modifier_Any it gets the key no matter which modifiers are held
+        // Works for KeyPressEvent, KeyReleaseEvent, KeyTypeEvent, MouseButtonClickEvent and MouseButtonReleaseEvent
+        template<typename T, typename F>
+        static ListenerHandle SubscribeKey(int key, F&& func, int modifiers = Modifier_Any, int priority = 0);
+
+        // Calls func once at the end of every Dispatch() with all of the events of type T it dispatched, like SubscribeBatch<MouseMoveEvent>([](EventSpan<MouseMoveEvent> moves) {})
+        // The events are in the order they were dispatched and are copied for it, so T has to be copyable
+        template<typename T, typename F>
+        static ListenerHandle SubscribeBatch(F&& func, int priority = 0);
+
+        // Parallel listeners are called on the job system threads (EventSystemConfig::WorkerThreads) after the serial listeners are done with a batch of events
+        // Listeners whose ListenerAccess doesn't conflict run at the same time, each one still gets its events in order on one thread at a time
+        // They skip events a serial listener has handled, and shouldn't call SetHandled() or anything on EventSystem but AddEvent() in the thread safe bus modes
+        static ListenerHandle AddParallelListener(EventListener listener, ListenerAccess access, int priority = 0);
+
+        template<typename T, typename F>
+        static ListenerHandle SubscribeParallel(F&& func, ListenerAccess access, int priority = 0);
+
+        // Calls func on another thread with a copy of every event of type T, so slow listeners (like a telemetry logger) don't hold up Dispatch()
+        // Each listener gets its events in order, but not necessarily before the next Dispatch(), and SetHandled() on the copy does nothing
+        // Mail that was posted before the listener was removed is still delivered, but removing it doesn't wait for that, even from inside the listener
+        template<typename T, typename F>
+        static ListenerHandle SubscribeOn(ListenerExecutor executor, F&& func, int priority = 0);
+
+        static size_t PumpMainThread(); // Calls the Executor_MainThread listeners with the events posted to them, one thread at a time, returns how many
+
+        // Returns false if the listener has already been removed
+        // Listeners can be added and removed from any thread, even by listeners while events are dispatched, added ones start with the next Dispatch()
+        // A listener removed from another thread can still get events from a Dispatch() that was already running
+        // Finding the listener is O(1), but the lists it's in are copied without it, so removing one costs O(n) in the listeners of its type,
+        // or of every type for AddEventListener() and SubscribeCategory() listeners
+        static bool RemoveEventListener(ListenerHandle handle);
+        static void Dispatch();                        // Dispatch all events
+
+        static size_t GetFrameArenaHighWaterMark();    // The most bytes a frame has needed from the frame arena, use it to size EventSystemConfig::FrameArenaSize
+
+        static uint64_t GetDroppedEventCount(EventTypeIndex type); // How many events of a type BusMode_Bounded has dropped or coalesced, pass an EventType or GetEventTypeIndex<T>()
+
+        // Merges bursts of an event type when they're added, pass an EventType or GetEventTypeIndex<T>()
+        // Call it before adding events, BusMode_LockFree and BusMode_ThreadLocal ignore it
+        static void SetCoalesceRule(EventTypeIndex type, CoalesceRule rule);
+
+        // Which lane events of a type go to when AddEvent() isn't given a priority, Priority_Normal by default
+        // Call it before adding events, only BusMode_TypeSegregated and BusMode_DoubleBuffered have lanes
+        static void SetEventPriority(EventTypeIndex type, EventPriority priority);
+
+    private:
+        template<typename T>
+        static void IterateThroughEventListeners(const T& e);
+
+        static ListenerHandle AddListener(EventListener listener, EventTypeIndex type, int categoryMask, int priority, ListenerOptions options = {});
+        static uint64_t MakeListenerKey(EventTypeIndex type, int key, int modifiers);
+        static void DispatchMerged(const IEvent& e, const std::vector<ListenerSlot*>* const* lists, size_t count);
+        static void InsertListener(ListenerRegistry& registry, ListenerSlot* slot);
+        static void BuildListenerTables(ListenerRegistry& registry); // adds tables for the event types that don't have one yet
+
+        // the writers, they hold sListenerMutex
+        static ListenerRegistry* CopyRegistry();
+
+        template<typename T>
+        static T& Unshare(std::shared_ptr<T>& shared); // a copy only this version points at, so it can be changed
+        static void PublishRegistry(ListenerRegistry* registry, uint32_t removedSlot);
+        static void ReclaimListeners();
+        static void DispatchBuses();
+        static void DispatchBatches();
+        static void DispatchParallel();          // runs the parallel listeners over sParallelEvents, called before the events they point at go away
+        static void BuildParallelWaves(ParallelSchedule& parallel);
+        static void RunParallelListener(const ListenerSlot& slot);
+
+        template<typename T>
+        static void DispatchCustomEvent(const void* e);
+
+        template<typename T, typename... Args>
+        static void Enqueue(EventPriority priority, Args&&... args);
+
+        template<typename T>
+        static void EnqueueBatch(const T* events, size_t count);
+
+        // the lock comes from LockBus(), so a batch can hold it for all of its events
+        template<typename T, typename... Args>
+        static void EnqueueLocked(std::unique_lock<std::mutex>& lock, EventPriority priority, Args&&... args);
+
+        // candidate is only set when the event has to be merged with the last one first, args then just move it
+        template<typename T, typename... Args>
+        static void EnqueueInPlace(std::unique_lock<std::mutex>& lock, EventPriority priority, CoalesceRule rule, T* candidate, Args&&... args);
+
+        template<typename T, typename... Args>
+        static EventNode* NewEventNode(Args&&... args);
+
+        static std::unique_lock<std::mutex> LockBus(); // locks whatever the bus mode needs locked while adding events
+
+        static CoalesceRule  GetCoalesceRule(EventTypeIndex type);
+        static EventPriority GetEventPriority(EventTypeIndex type);
+
+        static TimerHandle ScheduleTimer(TimerClock::time_point time, TimerClock::duration period, std::unique_ptr<ITimerPayload> payload);
+        static void AdvanceTimers();
+
+        static bool LanesEmpty(const EventBus* lanes);
+        static void DispatchLanes(EventBus* lanes);
+        static void DispatchNext(EventBus& bus);
+        static void DispatchVariantBus(VariantEventBus& bus);
+        static void DispatchLockFreeQueue();
+        static void DispatchProducerRings();
+        static void DispatchBoundedBus();
+        static ProducerRing& GetProducerRing();
+        static void DispatchVariant(const EventVariant& e);
+
+    private:
+        static EventSystemConfig sConfig;
+        static FrameArena sFrameArenas[2];             // the second one is only used by the double buffered bus
+        static EventBus sEventBuses[Priority_Count];
+        static EventBus sDispatchBuses[Priority_Count]; // the buses being drained, so listeners can add events while we iterate
+        static std::mutex sBackBusMutex;               // only held while pushing to or swapping sEventBuses in double buffered mode
+        static VariantEventBus sVariantBus;
+        static VariantEventBus sDispatchVariantBus;
+        static size_t sVariantBusSizeHint;
+        static MpscQueue sLockFreeQueue;
+        static std::vector<EventNode*> sDrainedNodes;  // the nodes popped by the running Dispatch(), kept until the parallel listeners are done with them
+        static std::vector<EventVariant> sDrainedEvents; // the same for the events moved out of the rings of BusMode_ThreadLocal and BusMode_Bounded
+        static std::mutex sProducerRingsMutex;         // only held when a thread adds its first event, and while Dispatch() looks for new threads
+        static std::vector<std::unique_ptr<ProducerRing>> sProducerRings;
+        static std::atomic<size_t> sOrphanedProducerRings; // so Dispatch() only looks for rings to free when a thread has exited
+        static std::vector<ProducerCursor> sProducerCursors; // where the running Dispatch() is in each ring, consumer thread only
+        static BoundedEventBus sBoundedBus;
+        static std::mutex sBoundedBusMutex;
+        static std::condition_variable sBoundedBusNotFull;
+        static thread_local bool tInsideDispatch;     // set on the thread running Dispatch(), and on a job system thread while it runs parallel listeners
+        static std::vector<CoalesceRule> sCoalesceRules;
+        static std::vector<EventPriority> sEventPriorities;
+        static TimingWheel sTimers;
+        static TimerClock::time_point sTimerStart;
+        static std::mutex sTimersMutex;
+        static std::mutex sListenerMutex;                 // only taken by the writers, Dispatch() never waits for it
+        static std::deque<ListenerSlot> sListenerSlots;   // a deque so slots never move, not even when listeners are added while dispatching
+        static std::vector<uint32_t> sFreeListenerSlots;
+        static ListenerRegistry sFirstRegistry;           // the empty version we start with, it's never freed
+        static std::atomic<ListenerRegistry*> sRegistry;  // the latest version
+        static ListenerRegistry* sDispatchRegistry;       // the version the running Dispatch() started with
+        static std::atomic<uint64_t> sGlobalEpoch;        // goes up every time a version is replaced
+        static std::atomic<uint64_t> sDispatchEpoch;      // the epoch the running Dispatch() started in, 0 when nothing is dispatching
+        static std::vector<RetiredListeners> sRetiredListeners;
+        static JobSystem sJobSystem;
+        static std::vector<ParallelEvent> sParallelEvents;
+        static MailQueue sMainThreadMail;
+        static ExecutorList sExecutorThreads;             // the Executor_Worker threads
+        static size_t sNextExecutorThread;
+        static ExecutorList sDedicatedExecutors;          // indexed by listener slot
+        static ExecutorList sStoppedExecutors;            // dedicated executors of removed listeners that are still delivering their mail
+        static std::mutex sExecutorsMutex;
+
+        static MailQueue* GetExecutorQueue(ListenerExecutor executor, std::unique_ptr<ExecutorThread>& dedicated);
+
+        template<typename T>
+        friend class NextEventAwaiter;
+
+        // not behind HELIOS_COROUTINES, the class has to be the same whatever standard a translation unit is built with
+        static bool HasWaiters(EventTypeIndex type);
+        static void WaitForEvent(EventTypeIndex type, EventWaiter* waiter);
+        static void ResumeWaiters(EventTypeIndex type, const IEvent& e);
+
+        static std::deque<EventWaiter> sEventWaiters; // the head of the wait list for every EventTypeIndex, a deque so they never move
+    };
+
+    template<typename T>
+    class EventTimerPayload : public ITimerPayload
+    {
+    public:
+        EventTimerPayload(T e) : mEvent(std::move(e)) {}
+
+        virtual void Fire() override
+        {
+            if constexpr (IsBuiltinEvent<T>::value)
+                EventSystem::AddEvent(mEvent);
+            else
+                EventSystem::AddCustomEvent(mEvent);
+        }
+
+    private:
+        T mEvent;
+    };
+
+    template<typename T>
+    inline TimerHandle EventSystem::AddEventAfter(T e, TimerClock::duration delay, TimerClock::duration period)
+    {
+        return AddEventAt(std::move(e), TimerClock::now() + delay, period);
+    }
+
+    template<typename T>
+    inline TimerHandle EventSystem::AddEventAt(T e, TimerClock::time_point time, TimerClock::duration period)
+    {
+        static_assert(std::is_base_of<IEvent, decltype(e)>::value);
+        static_assert(std::is_copy_constructible<T>::value, "the timer keeps the event and adds a copy every time it fires");
+        return ScheduleTimer(time, period, std::make_unique<EventTimerPayload<T>>(std::move(e)));
+    }
+
+    template<typename T>
+    inline void EventSystem::AddEvent(T e)
+    {
+        AddEventWithPriority<T>(GetEventPriority(GetEventTypeIndex<T>()), std::move(e));
+    }
+
+    template<typename T>
+    inline void EventSystem::AddEvent(T e, EventPriority priority)
+    {
+        AddEventWithPriority<T>(priority, std::move(e));
+    }
+
+    template<typename T, typename... Args, typename>
+    inline void EventSystem::AddEvent(Args&&... args)
+    {
+        AddEventWithPriority<T>(GetEventPriority(GetEventTypeIndex<T>()), std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename... Args>
+    inline void EventSystem::AddEventWithPriority(EventPriority priority, Args&&... args)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        static_assert(IsBuiltinEvent<T>::value, "use AddCustomEvent() for your own events");
+        Enqueue<T>(priority, std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    inline void EventSystem::AddCustomEvent(T e)
+    {
+        AddCustomEventWithPriority<T>(GetEventPriority(GetEventTypeIndex<T>()), std::move(e));
+    }
+
+    template<typename T>
+    inline void EventSystem::AddCustomEvent(T e, EventPriority priority)
+    {
+        AddCustomEventWithPriority<T>(priority, std::move(e));
+    }
+
+    template<typename T, typename... Args, typename>
+    inline void EventSystem::AddCustomEvent(Args&&... args)
+    {
+        AddCustomEventWithPriority<T>(GetEventPriority(GetEventTypeIndex<T>()), std::forward<Args>(args)...);
+    }
+
+    template<typename T, typename... Args>
+    inline void EventSystem::AddCustomEventWithPriority(EventPriority priority, Args&&... args)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        Enqueue<T>(priority, std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    inline void EventSystem::AddEvents(const T* events, size_t count)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        static_assert(IsBuiltinEvent<T>::value, "use AddCustomEvents() for your own events");
+        EnqueueBatch(events, count);
+    }
+
+    template<typename T>
+    inline void EventSystem::AddCustomEvents(const T* events, size_t count)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        EnqueueBatch(events, count);
+    }
+
+    template<typename T, typename F>
+    inline ListenerHandle EventSystem::Subscribe(F&& func, int priority)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+
+        EventListener listener = [func = std::forward<F>(func)](const IEvent& e) mutable
+        {
+            func(static_cast<const T&>(e));
+        };
+
+        return AddListener(std::move(listener), GetEventTypeIndex<T>(), 0, priority);
+    }
+
+    template<typename T, typename F>
+    inline ListenerHandle EventSystem::SubscribeKey(int key, F&& func, int modifiers, int priority)
+    {
+        static_assert(IsKeyedEvent<T>::value, "T doesn't have a key or button");
+
+        EventListener listener = [func = std::forward<F>(func)](const IEvent& e) mutable
+        {
+            func(static_cast<const T&>(e));
+        };
+
+        EventTypeIndex type = GetEventTypeIndex<T>();
+        ListenerOptions options;
+        options.Key = MakeListenerKey(type, key, modifiers);
+
+        return AddListener(std::move(listener), type, 0, priority, std::move(options));
+    }
+
+    template<typename T, typename F>
+    inline ListenerHandle EventSystem::SubscribeBatch(F&& func, int priority)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        static_assert(std::is_copy_constructible<T>::value, "batch listeners get copies of the events");
+
+        EventListener listener = [func = std::forward<F>(func)](const IEvent& e) mutable
+        {
+            const EventBatch& batch = static_cast<const EventBatch&>(e);
+            func(EventSpan<T>(static_cast<const T*>(batch.Data), batch.Size));
+        };
+
+        // events of this type are collected from the next Dispatch() on
+        ListenerOptions options;
+        options.Kind        = Listener_Batch;
+        options.BatchBuffer = std::make_shared<EventBatchBuffer<T>>();
+
+        return AddListener(std::move(listener), GetEventTypeIndex<T>(), 0, priority, std::move(options));
+    }
+
+    template<typename T, typename F>
+    inline ListenerHandle EventSystem::SubscribeOn(ListenerExecutor executor, F&& func, int priority)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        static_assert(std::is_copy_constructible<T>::value, "listeners on other threads get copies of the events");
+
+        if (executor == Executor_Inline)
+            return Subscribe<T>(std::forward<F>(func), priority);
+
+        using Mailbox = ListenerMailbox<T, std::decay_t<F>>;
+
+        ListenerOptions options;
+        MailQueue* queue = GetExecutorQueue(executor, options.Executor);
+
+        EventListener listener = MailPoster<T, std::decay_t<F>>(new Mailbox(std::forward<F>(func)), queue);
+        return AddListener(std::move(listener), GetEventTypeIndex<T>(), 0, priority, std::move(options));
+    }
+
+    template<typename T, typename F>
+    inline ListenerHandle EventSystem::SubscribeParallel(F&& func, ListenerAccess access, int priority)
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+
+        EventListener listener = [func = std::forward<F>(func)](const IEvent& e) mutable
+        {
+            func(static_cast<const T&>(e));
+        };
+
+        ListenerOptions options;
+        options.Kind   = Listener_Parallel;
+        options.Access = access;
+
+        return AddListener(std::move(listener), GetEventTypeIndex<T>(), 0, priority, std::move(options));
+    }
+
+    inline uint64_t EventSystem::MakeListenerKey(EventTypeIndex type, int key, int modifiers)
+    {
+        return (static_cast<uint64_t>(type) << 40) | (static_cast<uint64_t>(modifiers & 0xff) << 32) | static_cast<uint32_t>(key);
+    }
+
+    // defined here instead of in the implementation, AddEvent() takes its address for every event type
+    template<typename T>
+    inline void EventSystem::IterateThroughEventListeners(const T& e)
+    {
+        EventTypeIndex          type     = GetEventTypeIndex<T>();
+        const ListenerRegistry& registry = *sDispatchRegistry;
+
+        // batch listeners get them all together once the buses are drained
+        if constexpr (std::is_copy_constructible_v<T>)
+        {
+            if (type < registry.BatchBuffers.size() && registry.BatchBuffers[type])
+                static_cast<EventBatchBuffer<T>&>(*registry.BatchBuffers[type]).Add(e);
+        }
+
+        if (!registry.Parallel->Listeners.empty())
+            sParallelEvents.push_back({ &e, type, GetStaticEventCategory<T>() });
+
+        bool dispatched = false;
+
+        // two lookups find the listeners for this exact key and modifiers, and the ones for this key with any modifiers
+        if constexpr (IsKeyedEvent<T>::value)
+        {
+            // there are tables for every built-in type once any listener was added
+            if (!registry.KeyedListeners.Empty())
+            {
+                int      key   = GetEventKey(e);
+                uint32_t exact = registry.KeyedListeners.Find(MakeListenerKey(type, key, GetEventModifiers(e)));
+                uint32_t any   = registry.KeyedListeners.Find(MakeListenerKey(type, key, Modifier_Any));
+
+                if (exact != FlatIndexMap::NotFound || any != FlatIndexMap::NotFound)
+                {
+                    const std::vector<ListenerSlot*>* lists[] =
+                    {
+                        exact != FlatIndexMap::NotFound ? registry.KeyedLists[exact].get() : nullptr,
+                        any   != FlatIndexMap::NotFound ? registry.KeyedLists[any].get()   : nullptr,
+                        registry.Tables[type].get(),
+                    };
+
+                    DispatchMerged(e, lists, 3);
+                    dispatched = true;
+                }
+            }
+        }
+
+        // custom types that showed up after the last listener was added don't have a table yet, only the broad listeners can want them
+        if (!dispatched)
+        {
+            bool                              hasTable  = type < registry.Tables.size();
+            const std::vector<ListenerSlot*>& listeners = hasTable ? *registry.Tables[type] : *registry.EventListeners;
+
+            for (const ListenerSlot* slot : listeners)
+            {
+                if (!slot->Alive.load(std::memory_order_relaxed))
+                    continue;
+
+                if (!hasTable && !slot->Wants(GetStaticEventCategory<T>()))
+                    continue;
+
+                slot->Listener(e);
+
+                if (e.IsHandled())
+                    break;
+            }
+        }
+
+        // coroutines waiting in co_await NextEvent<T>() go after the listeners
+        if (HasWaiters(type) && !e.IsHandled())
+            ResumeWaiters(type, e);
+    }
+
+    inline bool EventSystem::HasWaiters(EventTypeIndex type)
+    {
+        return type < sEventWaiters.size() && sEventWaiters[type].Next != &sEventWaiters[type];
+    }
+
+    template<typename T>
+    inline void EventSystem::DispatchCustomEvent(const void* e)
+    {
+        IterateThroughEventListeners(*static_cast<const T*>(e));
+    }
+
+    inline CoalesceRule EventSystem::GetCoalesceRule(EventTypeIndex type)
+    {
+        return type < sCoalesceRules.size() ? sCoalesceRules[type] : Coalesce_None;
+    }
+
+    inline EventPriority EventSystem::GetEventPriority(EventTypeIndex type)
+    {
+        return type < sEventPriorities.size() ? sEventPriorities[type] : Priority_Normal;
+    }
+
+    template<typename T, typename... Args>
+    inline void EventSystem::Enqueue(EventPriority priority, Args&&... args)
+    {
+        std::unique_lock<std::mutex> lock = LockBus();
+        EnqueueLocked<T>(lock, priority, std::forward<Args>(args)...);
+    }
+
+    template<typename T>
+    inline void EventSystem::EnqueueBatch(const T* events, size_t count)
+    {
+        EventTypeIndex type     = GetEventTypeIndex<T>();
+        EventPriority  priority = GetEventPriority(type);
+
+        std::unique_lock<std::mutex> lock = LockBus();
+
+        // merging has to look at every event anyway
+        if (GetCoalesceRule(type) != Coalesce_None)
+        {
+            for (size_t i = 0; i < count; i++)
+                EnqueueLocked<T>(lock, priority, events[i]);
+            return;
+        }
+
+        switch (sConfig.BusMode)
+        {
+            case BusMode_TypeSegregated:
+            case BusMode_DoubleBuffered:
+                sEventBuses[priority].Append(&IterateThroughEventListeners<T>, events, count);
+                break;
+
+            case BusMode_LockFree:
+            {
+                if (count == 0)
+                    break;
+
+                // the nodes are linked up front, so other producers see the whole batch at once
+                EventNode* first = NewEventNode<T>(events[0]);
+                EventNode* last  = first;
+
+                for (size_t i = 1; i < count; i++)
+                {
+                    EventNode* node = NewEventNode<T>(events[i]);
+                    last->Next.store(node, std::memory_order_relaxed);
+                    last = node;
+                }
+
+                sLockFreeQueue.PushChain(first, last);
+                break;
+            }
+
+            case BusMode_Variant:
+                ReserveFrameVector(sVariantBus, sVariantBusSizeHint);
+                GrowFrameVector(sVariantBus, count);
+                [[fallthrough]];
+
+            default:
+                for (size_t i = 0; i < count; i++)
+                    EnqueueInPlace<T>(lock, priority, Coalesce_None, nullptr, events[i]);
+                break;
+        }
+    }
+
+    inline void EventSystem::AddEvents(const BuiltinEventVariant* events, size_t count)
+    {
+        std::unique_lock<std::mutex> lock = LockBus();
+
+        if (sConfig.BusMode == BusMode_Variant)
+        {
+            ReserveFrameVector(sVariantBus, sVariantBusSizeHint);
+            GrowFrameVector(sVariantBus, count);
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            std::visit([&lock](const auto& e)
+            {
+                using T = std::decay_t<decltype(e)>;
+                EnqueueLocked<T>(lock, GetEventPriority(GetEventTypeIndex<T>()), e);
+            }, events[i]);
+        }
+    }
+
+    template<typename T, typename... Args>
+    inline void EventSystem::EnqueueLocked(std::unique_lock<std::mutex>& lock, EventPriority priority, Args&&... args)
+    {
+        CoalesceRule rule = GetCoalesceRule(GetEventTypeIndex<T>());
+
+        if (rule == Coalesce_None)
+        {
+            EnqueueInPlace<T>(lock, priority, rule, nullptr, std::forward<Args>(args)...);
+        }
+        else
+        {
+            // merging needs the new event's value, so it's built here and only moved in if it wasn't merged
+            T e(std::forward<Args>(args)...);
+            EnqueueInPlace<T>(lock, priority, rule, &e, std::move(e));
+        }
+    }
+
+    template<typename T, typename... Args>
+    inline EventNode* EventSystem::NewEventNode(Args&&... args)
+    {
+        if constexpr (IsBuiltinEvent<T>::value)
+            return new EventNode(std::in_place_type<T>, std::forward<Args>(args)...);
+        else
+            return new EventNode(std::in_place_type<CustomEventBox>, std::in_place_type<T>, &DispatchCustomEvent<T>, nullptr, std::forward<Args>(args)...);
+    }
+
+    inline std::unique_lock<std::mutex> EventSystem::LockBus()
+    {
+        switch (sConfig.BusMode)
+        {
+            case BusMode_DoubleBuffered: return std::unique_lock<std::mutex>(sBackBusMutex);
+            case BusMode_Bounded:        return std::unique_lock<std::mutex>(sBoundedBusMutex);
+            default:                     return std::unique_lock<std::mutex>();
+        }
+    }
+
+    template<typename T, typename... Args>
+    inline void EventSystem::EnqueueInPlace(std::unique_lock<std::mutex>& lock, EventPriority priority, CoalesceRule rule, T* candidate, Args&&... args)
+    {
+        switch (sConfig.BusMode)
+        {
+            case BusMode_TypeSegregated:
+            case BusMode_DoubleBuffered:
+            {
+                EventBus& bus = sEventBuses[priority];
+
+                if (!candidate || !bus.CoalesceWithLast(*candidate, rule))
+                    bus.Emplace(&IterateThroughEventListeners<T>, std::forward<Args>(args)...);
+                break;
+            }
+
+            case BusMode_Variant:
+                if (candidate && !sVariantBus.empty() && CoalesceInto(sVariantBus.back(), *candidate, rule))
+                    break;
+
+                ReserveFrameVector(sVariantBus, sVariantBusSizeHint);
+
+                if constexpr (IsBuiltinEvent<T>::value)
+                    sVariantBus.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...);
+                else
+                    sVariantBus.emplace_back(std::in_place_type<CustomEventBox>, std::in_place_type<T>, &DispatchCustomEvent<T>, sVariantBus.get_allocator().GetArena(), std::forward<Args>(args)...);
+                break;
+
+            case BusMode_LockFree:
+                sLockFreeQueue.Push(NewEventNode<T>(std::forward<Args>(args)...));
+                break;
+
+            case BusMode_ThreadLocal:
+            {
+                ProducerRing& ring = GetProducerRing();
+
+                // the clock is monotonic, the max() makes stamps unique per thread
+                uint64_t now   = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+                uint64_t stamp = std::max(now, ring.LastStamp + 1);
+                ring.LastStamp = stamp;
+
+                // once an event has spilled, the ones after it follow until Dispatch() takes the overflow list
+                // otherwise room made by the Dispatch() before could let them overtake it through the ring
+                // TryEmplace() only uses args when there's room, so they're still intact for the overflow list
+                bool pushed = false;
+                if (!ring.HasOverflow.load(std::memory_order_relaxed))
+                {
+                    if constexpr (IsBuiltinEvent<T>::value)
+                        pushed = ring.Ring.TryEmplace(stamp, std::in_place_type<T>, std::forward<Args>(args)...);
+                    else
+                        pushed = ring.Ring.TryEmplace(stamp, std::in_place_type<CustomEventBox>, std::in_place_type<T>, &DispatchCustomEvent<T>, nullptr, std::forward<Args>(args)...);
+                }
+
+                if (!pushed)
+                {
+                    std::lock_guard<std::mutex> lock(ring.OverflowMutex);
+
+                    if constexpr (IsBuiltinEvent<T>::value)
+                        ring.Overflow.emplace_back(stamp, std::in_place_type<T>, std::forward<Args>(args)...);
+                    else
+                        ring.Overflow.emplace_back(stamp, std::in_place_type<CustomEventBox>, std::in_place_type<T>, &DispatchCustomEvent<T>, nullptr, std::forward<Args>(args)...);
+
+                    ring.HasOverflow.store(true, std::memory_order_release);
+                }
+                break;
+            }
+
+            case BusMode_Bounded:
+            {
+                if (candidate && !sBoundedBus.Empty() && CoalesceInto(sBoundedBus.Back(), *candidate, rule))
+                    break;
+
+                // a listener waiting for the Dispatch() it runs in to make room would never wake up, parallel ones included
+                if (sConfig.Overflow == Overflow_Block && !tInsideDispatch)
+                    sBoundedBusNotFull.wait(lock, []() { return !sBoundedBus.Full(); });
+
+                if constexpr (IsBuiltinEvent<T>::value)
+                    sBoundedBus.Push(EventVariant(std::in_place_type<T>, std::forward<Args>(args)...), sConfig.Overflow);
+                else
+                    sBoundedBus.Push(EventVariant(std::in_place_type<CustomEventBox>, std::in_place_type<T>, &DispatchCustomEvent<T>, nullptr, std::forward<Args>(args)...), sConfig.Overflow);
+                break;
+            }
+        }
+    }
+
+#ifdef HELIOS_COROUTINES
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Coroutines
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    // what co_await NextEvent<T>() waits on, it lives in the coroutine frame so waiting doesn't allocate
+    template<typename T>
+    class NextEventAwaiter : private EventWaiter
+    {
+    public:
+        NextEventAwaiter() = default;
+        NextEventAwaiter(const NextEventAwaiter&)            = delete;
+        NextEventAwaiter& operator=(const NextEventAwaiter&) = delete;
+
+        ~NextEventAwaiter() { Unlink(); } // the task was destroyed while it was waiting
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            Handle = handle.address();
+            Resume = [](void* address) { std::coroutine_handle<>::from_address(address).resume(); };
+            EventSystem::WaitForEvent(GetEventTypeIndex<T>(), this);
+        }
+
+        // the event only lives until the coroutine waits again (or returns), copy it if you need it longer
+        const T& await_resume() const noexcept { return static_cast<const T&>(*Event); }
+    };
+
+    // co_await NextEvent<KeyPressEvent>() suspends the coroutine until Dispatch() gets to the next KeyPressEvent
+    // it's resumed on the thread calling Dispatch(), after the listeners, unless one of them handled the event
+    template<typename T>
+    inline NextEventAwaiter<T> NextEvent()
+    {
+        static_assert(std::is_base_of<IEvent, T>::value);
+        return {};
+    }
+
+    // what a coroutine that waits for events returns, it starts right away and runs until the first co_await
+    // destroying the task destroys the coroutine wherever it's waiting, unless it was detached
+    class EventTask
+    {
+    public:
+        struct promise_type
+        {
+            bool Detached = false;
+
+            promise_type() = default; // so it's not an aggregate, or the coroutine's arguments would initialize it
+
+            EventTask get_return_object() { return EventTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+            std::suspend_never initial_suspend() noexcept { return {}; }
+
+            auto final_suspend() noexcept
+            {
+                struct FinalAwaiter
+                {
+                    bool Detached;
+
+                    bool await_ready() const noexcept { return Detached; } // a detached task cleans up after itself
+                    void await_suspend(std::coroutine_handle<>) const noexcept {}
+                    void await_resume() const noexcept {}
+                };
+
+                return FinalAwaiter{ Detached };
+            }
+
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+
+        EventTask() = default;
+        EventTask(const EventTask&)            = delete;
+        EventTask& operator=(const EventTask&) = delete;
+
+        EventTask(EventTask&& other) noexcept : mHandle(other.mHandle) { other.mHandle = nullptr; }
+
+        EventTask& operator=(EventTask&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                mHandle       = other.mHandle;
+                other.mHandle = nullptr;
+            }
+
+            return *this;
+        }
+
+        ~EventTask() { Reset(); }
+
+        bool IsDone() const { return !mHandle || mHandle.done(); }
+
+        // lets the coroutine run on its own, it's destroyed when it returns
+        void Detach()
+        {
+            if (!mHandle)
+                return;
+
+            if (mHandle.done())
+                mHandle.destroy();
+            else
+                mHandle.promise().Detached = true;
+
+            mHandle = nullptr;
+        }
+
+    private:
+        explicit EventTask(std::coroutine_handle<promise_type> handle) : mHandle(handle) {}
+
+        void Reset()
+        {
+            if (mHandle)
+                mHandle.destroy();
+
+            mHandle = nullptr;
+        }
+
+        std::coroutine_handle<promise_type> mHandle;
+    };
+#endif
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Static Event System
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    template<typename... Events>
+    struct EventList {};
+
+    template<typename... Listeners>
+    struct ListenerList {};
+
+    template<typename Events, typename Listeners>
+    class StaticEventSystem;
+
+    // an event system where every event type and listener is known at compile time, for builds that don't need to add listeners at runtime
+    // there's no type erasure, each event type gets its own code path that calls the listeners directly, so they can be inlined
+    // a listener is any default constructible class with an operator() for the events it wants, like void operator()(const KeyPressEvent& e)
+    //
+    // using Events = helios::StaticEventSystem<helios::EventList<KeyPressEvent, MouseMoveEvent>, helios::ListenerList<InputLayer, Camera>>;
+    // Events::AddEvent(KeyPressEvent(key));
+    // Events::Dispatch();
+    template<typename... Events, typename... Listeners>
+    class StaticEventSystem<EventList<Events...>, ListenerList<Listeners...>>
+    {
+    public:
+        template<typename T>
+        static void AddEvent(T e)
+        {
+            static_assert((std::is_same_v<T, Events> || ...), "T isn't in the EventList");
+            sEvents.emplace_back(std::in_place_type<T>, std::move(e));
+        }
+
+        // constructs the event right in the queue
+        template<typename T, typename... Args>
+        static void AddEvent(Args&&... args)
+        {
+            static_assert((std::is_same_v<T, Events> || ...), "T isn't in the EventList");
+            sEvents.emplace_back(std::in_place_type<T>, std::forward<Args>(args)...);
+        }
+
+        // events added by listeners are dispatched on the next pass, both queues keep their memory so it stops allocating after a few frames
+        static void Dispatch()
+        {
+            while (!sEvents.empty())
+            {
+                std::swap(sEvents, sDispatchEvents);
+
+                for (const std::variant<Events...>& e : sDispatchEvents)
+                    std::visit([](const auto& event) { DispatchEvent(event); }, e);
+
+                sDispatchEvents.clear();
+            }
+        }
+
+        template<typename L>
+        static L& GetListener() { return std::get<L>(sListeners); }
+
+    private:
+        // a fold over every listener, the ones that can't take a T are left out at compile time
+        template<typename T>
+        static void DispatchEvent(const T& e)
+        {
+            std::apply([&e](auto&... listeners) { (CallListener(listeners, e) || ...); }, sListeners);
+        }
+
+        // returns true if the event was handled, which skips the listeners after this one
+        template<typename L, typename T>
+        static bool CallListener(L& listener, const T& e)
+        {
+            if constexpr (std::is_invocable_v<L&, const T&>)
+            {
+                listener(e);
+
+                if constexpr (std::is_base_of_v<IEvent, T>)
+                    return e.IsHandled();
+            }
+
+            return false;
+        }
+
+    private:
+        inline static std::tuple<Listeners...>            sListeners;
+        inline static std::vector<std::variant<Events...>> sEvents;
+        inline static std::vector<std::variant<Events...>> sDispatchEvents;
+    };
+
+    //
+    ///////////////////////////////////////////////////////////////////////
+    // Utility
+    ///////////////////////////////////////////////////////////////////////
+    //
+
+    // helper class to use in an event listener to call functions if the event is a certain type
+
+    class EventDispatcher
+    {
+    public:
+        EventDispatcher(const IEvent& e)
+            : mEvent((IEvent&)e)
+        {
+        }
+
+        // T is the type of event
+        // F gets deduced by the compiler
+
+        template<typename T, typename F> 
+        void Dispatch(F&& func)
+        {
+            if (mEvent.GetType() == T::GetStaticType())
+                func(*static_cast<T*>(&mEvent));
+        }
+
+    private:
+        IEvent& mEvent;
+    };
+
+}
+
+#ifdef HELIOS_IMPLEMENTATION
+namespace helios
+{
+
+    EventSystemConfig          EventSystem::sConfig;
+    FrameArena                 EventSystem::sFrameArenas[2];
+    EventBus                   EventSystem::sEventBuses[Priority_Count];
+    EventBus                   EventSystem::sDispatchBuses[Priority_Count];
+    std::mutex                 EventSystem::sBackBusMutex;
+    VariantEventBus            EventSystem::sVariantBus;
+    VariantEventBus            EventSystem::sDispatchVariantBus;
+    size_t                     EventSystem::sVariantBusSizeHint = 0;
+    MpscQueue                  EventSystem::sLockFreeQueue;
+    std::vector<EventNode*>    EventSystem::sDrainedNodes;
+    std::vector<EventVariant>  EventSystem::sDrainedEvents;
+    std::mutex                 EventSystem::sProducerRingsMutex;
+    std::vector<std::unique_ptr<ProducerRing>> EventSystem::sProducerRings;
+    std::atomic<size_t>        EventSystem::sOrphanedProducerRings{ 0 };
+    std::vector<ProducerCursor> EventSystem::sProducerCursors;
+    BoundedEventBus            EventSystem::sBoundedBus;
+    std::mutex                 EventSystem::sBoundedBusMutex;
+    std::condition_variable    EventSystem::sBoundedBusNotFull;
+    thread_local bool          EventSystem::tInsideDispatch = false;
+    std::vector<CoalesceRule>  EventSystem::sCoalesceRules;
+    std::vector<EventPriority> EventSystem::sEventPriorities;
+    TimingWheel                EventSystem::sTimers;
+    TimerClock::time_point     EventSystem::sTimerStart = TimerClock::now();
+    std::mutex                 EventSystem::sTimersMutex;
+    std::mutex                 EventSystem::sListenerMutex;
+    std::deque<ListenerSlot>   EventSystem::sListenerSlots;
+    std::vector<uint32_t>      EventSystem::sFreeListenerSlots;
+    ListenerRegistry           EventSystem::sFirstRegistry;
+    std::atomic<ListenerRegistry*> EventSystem::sRegistry{ &sFirstRegistry };
+    ListenerRegistry*          EventSystem::sDispatchRegistry = nullptr;
+    std::atomic<uint64_t>      EventSystem::sGlobalEpoch{ 1 };
+    std::atomic<uint64_t>      EventSystem::sDispatchEpoch{ 0 };
+    std::vector<RetiredListeners> EventSystem::sRetiredListeners;
+    JobSystem                  EventSystem::sJobSystem;
+    std::vector<ParallelEvent> EventSystem::sParallelEvents;
+    MailQueue                  EventSystem::sMainThreadMail;
+    ExecutorList               EventSystem::sExecutorThreads;
+    size_t                     EventSystem::sNextExecutorThread = 0;
+    ExecutorList               EventSystem::sDedicatedExecutors;
+    ExecutorList               EventSystem::sStoppedExecutors;
+    std::mutex                 EventSystem::sExecutorsMutex;
+    std::deque<EventWaiter>    EventSystem::sEventWaiters;
+
+    void EventSystem::Init(const EventSystemConfig& config)
+    {
+        TimerClock::rep oldResolution = sConfig.TimerResolution.count();
+
+        sConfig = config;
+
+        // the timer wheel counts in multiples of the resolution, so it can't be shorter than one tick of the clock
+        if (sConfig.TimerResolution.count() <= 0)
+            sConfig.TimerResolution = TimerClock::duration(1);
+
+        // a ring with no room would always be full, Overflow_Block would wait forever
+        if (sConfig.BoundedCapacity == 0)
+            sConfig.BoundedCapacity = 1;
+
+        // pending timers keep the time they have left, counted in the new ticks (rounded up, so they never fire early)
+        if (sConfig.TimerResolution.count() != oldResolution)
+        {
+            TimerClock::rep resolution = sConfig.TimerResolution.count();
+
+            std::lock_guard<std::mutex> lock(sTimersMutex);
+            sTimerStart = TimerClock::now();
+            sTimers.Retime([=](uint64_t ticks) { return (ticks * oldResolution + resolution - 1) / resolution; });
+        }
+
+        FrameArena* arena     = nullptr;
+        FrameArena* backArena = nullptr;
+
+        if (sConfig.FrameArenaSize != 0)
+        {
+            sFrameArenas[0].Init(sConfig.FrameArenaSize);
+            arena     = &sFrameArenas[0];
+            backArena = arena;
+
+            // the back buffer keeps filling up while the front one is dispatched, so they can't share an arena
+            if (sConfig.BusMode == BusMode_DoubleBuffered)
+            {
+                sFrameArenas[1].Init(sConfig.FrameArenaSize);
+                backArena = &sFrameArenas[1];
+            }
+        }
+
+        switch (sConfig.BusMode)
+        {
+            case BusMode_TypeSegregated:
+            case BusMode_DoubleBuffered:
+                for (int lane = 0; lane < Priority_Count; lane++)
+                {
+                    sEventBuses[lane].SetArena(backArena);
+                    sDispatchBuses[lane].SetArena(arena);
+                }
+
+                // most events end up in the normal lane
+                sEventBuses[Priority_Normal].Reserve(sConfig.ReserveEvents);
+                sDispatchBuses[Priority_Normal].Reserve(sConfig.ReserveEvents);
+                break;
+
+            case BusMode_Variant:
+                sVariantBus         = VariantEventBus(arena);
+                sDispatchVariantBus = VariantEventBus(arena);
+
+                if (arena)
+                {
+                    sVariantBusSizeHint = sConfig.ReserveEvents;
+                }
+                else
+                {
+                    sVariantBus.reserve(sConfig.ReserveEvents);
+                    sDispatchVariantBus.reserve(sConfig.ReserveEvents);
+                }
+                break;
+
+            case BusMode_Bounded:
+            {
+                std::lock_guard<std::mutex> lock(sBoundedBusMutex);
+                sBoundedBus.Init(sConfig.BoundedCapacity);
+                break;
+            }
+
+            default:
+                break;
+        }
+
+        sJobSystem.Start(sConfig.WorkerThreads);
+    }
+
+    size_t EventSystem::GetFrameArenaHighWaterMark()
+    {
+        return std::max(sFrameArenas[0].GetHighWaterMark(), sFrameArenas[1].GetHighWaterMark());
+    }
+
+    ListenerHandle EventSystem::AddEventListener(EventListener e, int priority)
+    {
+        return AddListener(e, ListenerSlot::AnyType, 0, priority);
+    }
+
+    ListenerHandle EventSystem::SubscribeCategory(int categoryMask, EventListener listener, int priority)
+    {
+        return AddListener(listener, ListenerSlot::AnyType, categoryMask, priority);
+    }
+
+    ListenerHandle EventSystem::AddParallelListener(EventListener listener, ListenerAccess access, int priority)
+    {
+        ListenerOptions options;
+        options.Kind   = Listener_Parallel;
+        options.Access = access;
+
+        return AddListener(listener, ListenerSlot::AnyType, 0, priority, std::move(options));
+    }
+
+    bool EventSystem::RemoveEventListener(ListenerHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(sListenerMutex);
+
+        if (handle.Index >= sListenerSlots.size())
+            return false;
+
+        ListenerSlot& slot = sListenerSlots[handle.Index];
+
+        if (!slot.Alive.load(std::memory_order_relaxed) || slot.Generation != handle.Generation)
+            return false;
+
+        // the listener might be running right now, so it's only destroyed once no Dispatch() can see it
+        slot.Alive.store(false, std::memory_order_relaxed);
+        slot.Generation++;
+
+        ListenerRegistry* registry = CopyRegistry();
+        auto              erase    = [&slot](std::vector<ListenerSlot*>& listeners) { listeners.erase(std::remove(listeners.begin(), listeners.end(), &slot), listeners.end()); };
+
+        // only the lists InsertListener() put it in are copied, the rest stay shared with the old version
+        if (slot.Kind == Listener_Parallel)
+        {
+            ParallelSchedule& parallel = Unshare(registry->Parallel);
+            erase(parallel.Listeners);
+            BuildParallelWaves(parallel);
+        }
+        else if (slot.Kind == Listener_Batch)
+        {
+            erase(Unshare(registry->BatchLists[slot.Type]));
+
+            // nobody reads the events of this type anymore, so stop collecting them. a Dispatch() still using the old version keeps its own reference
+            if (registry->BatchLists[slot.Type]->empty())
+                registry->BatchBuffers[slot.Type].reset();
+        }
+        else if (slot.Key != ListenerSlot::NoKey)
+        {
+            erase(Unshare(registry->KeyedLists[registry->KeyedListeners.Find(slot.Key)]));
+        }
+        else if (slot.Type != ListenerSlot::AnyType)
+        {
+            erase(Unshare(registry->Tables[slot.Type]));
+        }
+        else
+        {
+            EventTypeRegistry& types = GetEventTypeRegistry();
+            std::lock_guard<std::mutex> typesLock(types.Mutex);
+
+            for (size_t type = 0; type < registry->Tables.size(); type++)
+                if (slot.Wants(types.Categories[type]))
+                    erase(Unshare(registry->Tables[type]));
+
+            erase(Unshare(registry->EventListeners));
+        }
+
+        PublishRegistry(registry, handle.Index);
+        return true;
+    }
+
+    ListenerHandle EventSystem::AddListener(EventListener listener, EventTypeIndex type, int categoryMask, int priority, ListenerOptions options)
+    {
+        std::lock_guard<std::mutex> lock(sListenerMutex);
+
+        uint32_t index;
+
+        if (!sFreeListenerSlots.empty())
+        {
+            index = sFreeListenerSlots.back();
+            sFreeListenerSlots.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(sListenerSlots.size());
+            sListenerSlots.emplace_back();
+        }
+
+        ListenerSlot& slot = sListenerSlots[index];
+        slot.Listener     = std::move(listener);
+        slot.Type         = type;
+        slot.CategoryMask = categoryMask;
+        slot.Key          = options.Key;
+        slot.Priority     = priority;
+        slot.Kind         = options.Kind;
+        slot.Access       = options.Access;
+        slot.Alive.store(true, std::memory_order_relaxed);
+
+        if (options.Executor)
+        {
+            if (index >= sDedicatedExecutors.size())
+                sDedicatedExecutors.resize(index + 1);
+
+            sDedicatedExecutors[index] = std::move(options.Executor);
+        }
+
+        ListenerRegistry* registry = CopyRegistry();
+
+        if (options.BatchBuffer)
+        {
+            if (type >= registry->BatchBuffers.size())
+                registry->BatchBuffers.resize(type + 1);
+
+            if (!registry->BatchBuffers[type])
+                registry->BatchBuffers[type] = std::move(options.BatchBuffer);
+        }
+
+        // a Dispatch() that's running keeps the version it started with, so this listener starts with the next one
+        InsertListener(*registry, &slot);
+        PublishRegistry(registry, RetiredListeners::NoSlot);
+
+        return { index, slot.Generation };
+    }
+
+    // the category and priority are dealt with once here, so dispatching never looks at them
+    void EventSystem::InsertListener(ListenerRegistry& registry, ListenerSlot* slot)
+    {
+        BuildListenerTables(registry);
+
+        // after every listener with the same or a higher priority
+        auto insert = [slot](std::vector<ListenerSlot*>& listeners)
+        {
+            auto position = std::upper_bound(listeners.begin(), listeners.end(), slot, [](const ListenerSlot* a, const ListenerSlot* b) { return a->Priority > b->Priority; });
+            listeners.insert(position, slot);
+        };
+
+        if (slot->Kind == Listener_Parallel)
+        {
+            ParallelSchedule& parallel = Unshare(registry.Parallel);
+            insert(parallel.Listeners);
+            BuildParallelWaves(parallel);
+            return;
+        }
+
+        if (slot->Kind == Listener_Batch)
+        {
+            if (slot->Type >= registry.BatchLists.size())
+                registry.BatchLists.resize(slot->Type + 1);
+
+            insert(Unshare(registry.BatchLists[slot->Type]));
+            return;
+        }
+
+        if (slot->Key != ListenerSlot::NoKey)
+        {
+            uint32_t list = registry.KeyedListeners.Find(slot->Key);
+
+            if (list == FlatIndexMap::NotFound)
+            {
+                list = static_cast<uint32_t>(registry.KeyedLists.size());
+                registry.KeyedListeners.Insert(slot->Key, list);
+                registry.KeyedLists.emplace_back();
+            }
+
+            insert(Unshare(registry.KeyedLists[list]));
+            return;
+        }
+
+        if (slot->Type != ListenerSlot::AnyType)
+        {
+            insert(Unshare(registry.Tables[slot->Type]));
+            return;
+        }
+
+        EventTypeRegistry& types = GetEventTypeRegistry();
+        std::lock_guard<std::mutex> lock(types.Mutex);
+
+        for (size_t type = 0; type < registry.Tables.size(); type++)
+            if (slot->Wants(types.Categories[type]))
+                insert(Unshare(registry.Tables[type]));
+
+        insert(Unshare(registry.EventListeners));
+    }
+
+    ListenerRegistry* EventSystem::CopyRegistry()
+    {
+        return new ListenerRegistry(*sRegistry.load(std::memory_order_relaxed));
+    }
+
+    template<typename T>
+    T& EventSystem::Unshare(std::shared_ptr<T>& shared)
+    {
+        // the old version might be in use by a Dispatch(), so it's never changed in place
+        shared = shared ? std::make_shared<T>(*shared) : std::make_shared<T>();
+        return *shared;
+    }
+
+    void EventSystem::PublishRegistry(ListenerRegistry* registry, uint32_t removedSlot)
+    {
+        ListenerRegistry* old = sRegistry.exchange(registry, std::memory_order_seq_cst);
+
+        // a Dispatch() that starts in this epoch or later can only see the new version
+        uint64_t epoch = sGlobalEpoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        sRetiredListeners.push_back({ epoch, old, removedSlot });
+        ReclaimListeners();
+    }
+
+    void EventSystem::ReclaimListeners()
+    {
+        uint64_t dispatching = sDispatchEpoch.load(std::memory_order_seq_cst);
+        size_t   kept        = 0;
+
+        for (size_t i = 0; i < sRetiredListeners.size(); i++)
+        {
+            RetiredListeners retired = sRetiredListeners[i];
+
+            // the running Dispatch() started before this was retired, so it could still be looking at it
+            if (dispatching != 0 && dispatching < retired.Epoch)
+            {
+                sRetiredListeners[kept++] = retired;
+                continue;
+            }
+
+            if (retired.Registry != &sFirstRegistry)
+                delete retired.Registry;
+
+            if (retired.Slot != RetiredListeners::NoSlot)
+            {
+                sListenerSlots[retired.Slot].Listener = EventListener();
+                sFreeListenerSlots.push_back(retired.Slot);
+
+                // this might be the executor's own thread, or Dispatch() with a long backlog still queued, so nothing waits for it
+                if (retired.Slot < sDedicatedExecutors.size() && sDedicatedExecutors[retired.Slot])
+                {
+                    sDedicatedExecutors[retired.Slot]->Stop();
+                    sStoppedExecutors.push_back(std::move(sDedicatedExecutors[retired.Slot]));
+                }
+            }
+        }
+
+        sRetiredListeners.resize(kept);
+
+        // the ones that delivered all their mail are joined, which doesn't block anymore
+        sStoppedExecutors.erase(std::remove_if(sStoppedExecutors.begin(), sStoppedExecutors.end(), [](const std::unique_ptr<ExecutorThread>& executor) { return executor->IsFinished(); }), sStoppedExecutors.end());
+    }
+
+    // walks a few lists that are each sorted by priority as if they were one, earlier lists go first when priorities are equal
+    void EventSystem::DispatchMerged(const IEvent& e, const std::vector<ListenerSlot*>* const* lists, size_t count)
+    {
+        size_t positions[4] = {}; // keyed events need three at most
+
+        while (true)
+        {
+            const ListenerSlot* next = nullptr;
+            size_t              from = 0;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!lists[i] || positions[i] == lists[i]->size())
+                    continue;
+
+                const ListenerSlot* slot = (*lists[i])[positions[i]];
+
+                if (!next || slot->Priority > next->Priority)
+                {
+                    next = slot;
+                    from = i;
+                }
+            }
+
+            if (!next)
+                return;
+
+            positions[from]++;
+
+            if (!next->Alive.load(std::memory_order_relaxed))
+                continue;
+
+            next->Listener(e);
+
+            if (e.IsHandled())
+                return;
+        }
+    }
+
+    void EventSystem::DispatchBatches()
+    {
+        const ListenerRegistry& registry = *sDispatchRegistry;
+
+        for (size_t type = 0; type < registry.BatchBuffers.size(); type++)
+        {
+            IEventBatchBuffer* buffer = registry.BatchBuffers[type].get();
+
+            if (!buffer || buffer->Size() == 0)
+                continue;
+
+            EventBatch batch;
+            batch.Data = buffer->Data();
+            batch.Size = buffer->Size();
+
+            if (type < registry.BatchLists.size() && registry.BatchLists[type])
+                for (const ListenerSlot* slot : *registry.BatchLists[type])
+                    if (slot->Alive.load(std::memory_order_relaxed))
+                        slot->Listener(batch);
+
+            buffer->Clear();
+        }
+    }
+
+    void EventSystem::WaitForEvent(EventTypeIndex type, EventWaiter* waiter)
+    {
+        while (sEventWaiters.size() <= type)
+        {
+            EventWaiter& head = sEventWaiters.emplace_back();
+            head.Prev = &head;
+            head.Next = &head;
+        }
+
+        // at the back, so coroutines are resumed in the order they started waiting
+        EventWaiter& head = sEventWaiters[type];
+        waiter->Prev     = head.Prev;
+        waiter->Next     = &head;
+        head.Prev->Next  = waiter;
+        head.Prev        = waiter;
+    }
+
+    void EventSystem::ResumeWaiters(EventTypeIndex type, const IEvent& e)
+    {
+        // the whole list is taken first, so a coroutine that waits for this type again gets the next event and not this one
+        EventWaiter& head = sEventWaiters[type];
+        EventWaiter  resuming;
+
+        resuming.Next       = head.Next;
+        resuming.Prev       = head.Prev;
+        resuming.Next->Prev = &resuming;
+        resuming.Prev->Next = &resuming;
+        head.Next           = &head;
+        head.Prev           = &head;
+
+        // a resumed coroutine can destroy tasks that are still in the list, their waiters unlink themselves
+        while (resuming.Next != &resuming)
+        {
+            EventWaiter* waiter = resuming.Next;
+            waiter->Unlink();
+            waiter->Event = &e;
+            waiter->Resume(waiter->Handle);
+        }
+    }
+
+    size_t EventSystem::PumpMainThread()
+    {
+        return sMainThreadMail.Drain();
+    }
+
+    MailQueue* EventSystem::GetExecutorQueue(ListenerExecutor executor, std::unique_ptr<ExecutorThread>& dedicated)
+    {
+        switch (executor)
+        {
+            case Executor_MainThread:
+                return &sMainThreadMail;
+
+            case Executor_Worker:
+            {
+                std::lock_guard<std::mutex> lock(sExecutorsMutex);
+
+                if (sExecutorThreads.empty())
+                    for (size_t i = 0; i < std::max<size_t>(sConfig.ExecutorThreads, 1); i++)
+                        sExecutorThreads.push_back(std::make_unique<ExecutorThread>());
+
+                // every listener sticks to one thread, so it gets its events in order
+                return sExecutorThreads[sNextExecutorThread++ % sExecutorThreads.size()].get();
+            }
+
+            default:
+                dedicated = std::make_unique<ExecutorThread>();
+                return dedicated.get();
+        }
+    }
+
+    void EventSystem::DispatchParallel()
+    {
+        if (sParallelEvents.empty())
+            return;
+
+        for (std::vector<ListenerSlot*>& wave : sDispatchRegistry->Parallel->Waves)
+        {
+            sJobSystem.Run(wave.size(), [](void* context, size_t index)
+            {
+                // the job system threads are part of this Dispatch() while they run a listener
+                bool inside = tInsideDispatch;
+                tInsideDispatch = true;
+                RunParallelListener(*(*static_cast<std::vector<ListenerSlot*>*>(context))[index]);
+                tInsideDispatch = inside;
+            }, &wave);
+        }
+
+        sParallelEvents.clear();
+    }
+
+    // every listener goes in the wave after the last one it conflicts with, so conflicting listeners keep their priority order
+    void EventSystem::BuildParallelWaves(ParallelSchedule& parallel)
+    {
+        const std::vector<ListenerSlot*>&        listeners = parallel.Listeners;
+        std::vector<std::vector<ListenerSlot*>>& waves     = parallel.Waves;
+        std::vector<size_t>                      waveOf(listeners.size());
+
+        waves.clear();
+
+        for (size_t i = 0; i < listeners.size(); i++)
+        {
+            size_t wave = 0;
+
+            for (size_t before = 0; before < i; before++)
+                if (listeners[before]->Access.ConflictsWith(listeners[i]->Access))
+                    wave = std::max(wave, waveOf[before] + 1);
+
+            if (wave >= waves.size())
+                waves.resize(wave + 1);
+
+            waveOf[i] = wave;
+            waves[wave].push_back(listeners[i]);
+        }
+    }
+
+    void EventSystem::RunParallelListener(const ListenerSlot& slot)
+    {
+        // removed while this Dispatch() was running
+        if (!slot.Alive.load(std::memory_order_relaxed))
+            return;
+
+        for (const ParallelEvent& e : sParallelEvents)
+        {
+            if (e.Event->IsHandled())
+                continue;
+
+            if (slot.Type == ListenerSlot::AnyType ? slot.Wants(e.Category) : slot.Type == e.Type)
+                slot.Listener(*e.Event);
+        }
+    }
+
+    void EventSystem::BuildListenerTables(ListenerRegistry& registry)
+    {
+        EventTypeRegistry& types = GetEventTypeRegistry();
+        std::lock_guard<std::mutex> lock(types.Mutex);
+
+        // a new table starts out with the broad listeners that want its category, they're already sorted by priority
+        for (size_t type = registry.Tables.size(); type < types.Categories.size(); type++)
+        {
+            std::vector<ListenerSlot*>& listeners = *registry.Tables.emplace_back(std::make_shared<std::vector<ListenerSlot*>>());
+
+            for (ListenerSlot* broad : *registry.EventListeners)
+                if (broad->Wants(types.Categories[type]))
+                    listeners.push_back(broad);
+        }
+    }
+
+    void EventSystem::Dispatch()
+    {
+        // timers and batch listeners add events on this thread too, so it's marked for the whole Dispatch()
+        tInsideDispatch = true;
+
+        AdvanceTimers();
+
+        // the epoch goes first, so a writer either sees it and keeps the version we're about to load, or published before we load it
+        sDispatchEpoch.store(sGlobalEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        sDispatchRegistry = sRegistry.load(std::memory_order_seq_cst);
+
+        DispatchBuses();
+        DispatchBatches();
+
+        tInsideDispatch = false;
+
+        sDispatchRegistry = nullptr;
+        sDispatchEpoch.store(0, std::memory_order_seq_cst);
+
+        // the versions retired while dispatching can go now, unless a writer has the lock, then it frees them itself
+        std::unique_lock<std::mutex> lock(sListenerMutex, std::try_to_lock);
+
+        if (lock.owns_lock())
+            ReclaimListeners();
+    }
+
+    void EventSystem::DispatchBuses()
+    {
+        // events added by listeners end up in the other bus and get dispatched on the next pass
+        switch (sConfig.BusMode)
+        {
+            case BusMode_TypeSegregated:
+                while (!LanesEmpty(sEventBuses))
+                {
+                    std::swap(sEventBuses, sDispatchBuses);
+                    DispatchLanes(sDispatchBuses);
+                }
+                break;
+
+            case BusMode_Variant:
+                while (!sVariantBus.empty())
+                {
+                    std::swap(sVariantBus, sDispatchVariantBus);
+                    DispatchVariantBus(sDispatchVariantBus);
+                }
+                break;
+
+            case BusMode_DoubleBuffered:
+            {
+                // producers only wait for the swap, not for the listeners
+                // events they add from now on (listeners included) go to the next Dispatch()
+                {
+                    std::lock_guard<std::mutex> lock(sBackBusMutex);
+                    std::swap(sEventBuses, sDispatchBuses);
+                }
+
+                DispatchLanes(sDispatchBuses);
+
+                if (FrameArena* arena = sDispatchBuses[0].GetArena())
+                    arena->Reset();
+
+                return;
+            }
+
+            case BusMode_LockFree:
+                DispatchLockFreeQueue();
+                break;
+
+            case BusMode_ThreadLocal:
+                DispatchProducerRings();
+                break;
+
+            case BusMode_Bounded:
+                DispatchBoundedBus();
+                break;
+        }
+
+        // nothing points into the arena anymore
+        sFrameArenas[0].Reset();
+    }
+
+    bool EventSystem::LanesEmpty(const EventBus* lanes)
+    {
+        for (int lane = 0; lane < Priority_Count; lane++)
+            if (!lanes[lane].Empty())
+                return false;
+
+        return true;
+    }
+
+    void EventSystem::DispatchLanes(EventBus* lanes)
+    {
+        // higher priorities go first, unless PriorityBurst events in a row have gone by while a lower lane was waiting
+        size_t burst = 0;
+
+        while (true)
+        {
+            int lane = 0;
+            while (lane < Priority_Count && lanes[lane].Empty())
+                lane++;
+
+            if (lane == Priority_Count)
+                break;
+
+            if (sConfig.PriorityBurst != 0 && burst >= sConfig.PriorityBurst)
+            {
+                burst = 0;
+
+                int lower = lane + 1;
+                while (lower < Priority_Count && lanes[lower].Empty())
+                    lower++;
+
+                if (lower < Priority_Count)
+                {
+                    DispatchNext(lanes[lower]);
+                    continue;
+                }
+            }
+
+            DispatchNext(lanes[lane]);
+            burst++;
+        }
+
+        DispatchParallel();
+
+        for (int lane = 0; lane < Priority_Count; lane++)
+            lanes[lane].Clear();
+    }
+
+    void EventSystem::DispatchNext(EventBus& bus)
+    {
+        switch (bus.PeekType())
+        {
+            case Type_WindowCreate:         IterateThroughEventListeners(bus.Next<WindowCreateEvent>());       break;
+            case Type_WindowDestroy:        IterateThroughEventListeners(bus.Next<WindowDestroyEvent>());      break;
+            case Type_WindowMove:           IterateThroughEventListeners(bus.Next<WindowMoveEvent>());         break;
+            case Type_WindowResize:         IterateThroughEventListeners(bus.Next<WindowResizeEvent>());       break;
+            case Type_KeyPress:             IterateThroughEventListeners(bus.Next<KeyPressEvent>());           break;
+            case Type_KeyRelease:           IterateThroughEventListeners(bus.Next<KeyReleaseEvent>());         break;
+            case Type_KeyType:              IterateThroughEventListeners(bus.Next<KeyTypeEvent>());            break;
+            case Type_MouseScroll:          IterateThroughEventListeners(bus.Next<MouseScrollEvent>());        break;
+            case Type_MouseMove:            IterateThroughEventListeners(bus.Next<MouseMoveEvent>());          break;
+            case Type_MouseButtonClick:     IterateThroughEventListeners(bus.Next<MouseButtonClickEvent>());   break;
+            case Type_MouseButtonRelease:   IterateThroughEventListeners(bus.Next<MouseButtonReleaseEvent>()); break;
+            default:                        bus.DispatchNext();                                                break; // custom events
+        }
+    }
+
+    void EventSystem::DispatchVariantBus(VariantEventBus& bus)
+    {
+        for (const EventVariant& event : bus)
+            DispatchVariant(event);
+
+        DispatchParallel();
+        ResetFrameVector(bus, sVariantBusSizeHint);
+    }
+
+    void EventSystem::DispatchLockFreeQueue()
+    {
+        // an event that is still being pushed is picked up by the next Dispatch()
+        while (MpscNode* node = sLockFreeQueue.Pop())
+        {
+            EventNode* eventNode = static_cast<EventNode*>(node);
+            DispatchVariant(eventNode->Event);
+            sDrainedNodes.push_back(eventNode);
+        }
+
+        DispatchParallel();
+
+        for (EventNode* eventNode : sDrainedNodes)
+            delete eventNode;
+
+        sDrainedNodes.clear();
+    }
+
+    void EventSystem::DispatchBoundedBus()
+    {
+        // each pass takes everything that's queued with one lock, so the producers get all of the room back at once
+        // and the parallel listeners run once per pass. events added while a pass is dispatched go in the next one
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(sBoundedBusMutex);
+
+                while (!sBoundedBus.Empty())
+                    sDrainedEvents.push_back(sBoundedBus.PopFront());
+            }
+
+            if (sDrainedEvents.empty())
+                break;
+
+            sBoundedBusNotFull.notify_all();
+
+            for (const EventVariant& event : sDrainedEvents)
+                DispatchVariant(event);
+
+            DispatchParallel();
+            sDrainedEvents.clear();
+        }
+    }
+
+    void EventSystem::SetCoalesceRule(EventTypeIndex type, CoalesceRule rule)
+    {
+        if (type >= sCoalesceRules.size())
+            sCoalesceRules.resize(type + 1, Coalesce_None);
+
+        sCoalesceRules[type] = rule;
+    }
+
+    TimerHandle EventSystem::ScheduleTimer(TimerClock::time_point time, TimerClock::duration period, std::unique_ptr<ITimerPayload> payload)
+    {
+        // round up, so the event is never added before the time asked for
+        TimerClock::rep resolution = sConfig.TimerResolution.count();
+        TimerClock::rep offset     = std::max<TimerClock::rep>((time - sTimerStart).count(), 0);
+        uint64_t        expiry     = static_cast<uint64_t>((offset + resolution - 1) / resolution);
+        uint64_t        ticks      = static_cast<uint64_t>((period.count() + resolution - 1) / resolution);
+
+        if (period.count() > 0 && ticks == 0)
+            ticks = 1;
+
+        std::lock_guard<std::mutex> lock(sTimersMutex);
+        return sTimers.Schedule(expiry, ticks, std::move(payload));
+    }
+
+    bool EventSystem::CancelTimer(TimerHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(sTimersMutex);
+        return sTimers.Cancel(handle);
+    }
+
+    void EventSystem::AdvanceTimers()
+    {
+        uint64_t now = static_cast<uint64_t>((TimerClock::now() - sTimerStart).count() / sConfig.TimerResolution.count());
+
+        std::lock_guard<std::mutex> lock(sTimersMutex);
+        sTimers.Advance(now);
+    }
+
+    void EventSystem::SetEventPriority(EventTypeIndex type, EventPriority priority)
+    {
+        if (type >= sEventPriorities.size())
+            sEventPriorities.resize(type + 1, Priority_Normal);
+
+        sEventPriorities[type] = priority;
+    }
+
+    uint64_t EventSystem::GetDroppedEventCount(EventTypeIndex type)
+    {
+        std::lock_guard<std::mutex> lock(sBoundedBusMutex);
+        return sBoundedBus.GetDropCount(type);
+    }
+
+    ProducerRing& EventSystem::GetProducerRing()
+    {
+        // when the thread exits its ring may still have events queued, so it's only marked
+        // and DispatchProducerRings() frees it once they've been dispatched
+        struct RingOwner
+        {
+            ProducerRing* Ring = nullptr;
+
+            ~RingOwner()
+            {
+                if (!Ring)
+                    return;
+
+                Ring->Orphaned.store(true, std::memory_order_release);
+                sOrphanedProducerRings.fetch_add(1, std::memory_order_release);
+            }
+        };
+
+        thread_local RingOwner tOwner;
+
+        if (!tOwner.Ring)
+        {
+            std::lock_guard<std::mutex> lock(sProducerRingsMutex);
+            sProducerRings.push_back(std::make_unique<ProducerRing>(sConfig.ThreadRingSize));
+            tOwner.Ring = sProducerRings.back().get();
+        }
+
+        return *tOwner.Ring;
+    }
+
+    void EventSystem::DispatchProducerRings()
+    {
+        // each ring and each overflow list is already sorted by stamp, so this is a k-way merge
+        // events added after we took the snapshot, by listeners too, are left for the next Dispatch()
+        sProducerCursors.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(sProducerRingsMutex);
+
+            // take the overflow before sizing the rings. a ring only gets events while its overflow list is empty, so every
+            // ring event added before a spilled one is counted below, and one that spills after this point is newer than the ring
+            for (auto& ring : sProducerRings)
+            {
+                if (!ring->HasOverflow.load(std::memory_order_acquire))
+                    continue;
+
+                std::lock_guard<std::mutex> overflowLock(ring->OverflowMutex);
+                std::swap(ring->Overflow, ring->DispatchOverflow);
+                ring->HasOverflow.store(false, std::memory_order_relaxed);
+            }
+
+            for (auto& ring : sProducerRings)
+            {
+                if (size_t count = ring->Ring.Size())
+                    sProducerCursors.push_back({ ring.get(), false, 0, count });
+
+                if (size_t count = ring->DispatchOverflow.size())
+                    sProducerCursors.push_back({ ring.get(), true, 0, count });
+            }
+        }
+
+        while (true)
+        {
+            ProducerCursor* next = nullptr;
+
+            // ties go to the first cursor, so the order doesn't depend on timing
+            for (ProducerCursor& cursor : sProducerCursors)
+                if (cursor.Index < cursor.Count && (!next || cursor.Front().Stamp < next->Front().Stamp))
+                    next = &cursor;
+
+            if (!next)
+                break;
+
+            // the ring slot can be reused as soon as it's popped, so the event is moved out first
+            sDrainedEvents.push_back(std::move(next->Front().Event));
+
+            if (!next->Overflow)
+                next->Ring->Ring.Pop();
+
+            next->Index++;
+        }
+
+        for (ProducerCursor& cursor : sProducerCursors)
+            if (cursor.Overflow)
+                cursor.Ring->DispatchOverflow.clear();
+
+        for (const EventVariant& event : sDrainedEvents)
+            DispatchVariant(event);
+
+        DispatchParallel();
+        sDrainedEvents.clear();
+
+        if (sOrphanedProducerRings.load(std::memory_order_acquire) == 0)
+            return;
+
+        // Orphaned is read first, so everything its thread added before exiting is seen by the checks after it
+        std::lock_guard<std::mutex> lock(sProducerRingsMutex);
+
+        auto drained = [](const std::unique_ptr<ProducerRing>& ring)
+        {
+            return ring->Orphaned.load(std::memory_order_acquire) && ring->Ring.Size() == 0 && !ring->HasOverflow.load(std::memory_order_acquire) && ring->DispatchOverflow.empty();
+        };
+
+        auto freed = std::remove_if(sProducerRings.begin(), sProducerRings.end(), drained);
+        sOrphanedProducerRings.fetch_sub(sProducerRings.end() - freed, std::memory_order_relaxed);
+        sProducerRings.erase(freed, sProducerRings.end());
+    }
+
+    void EventSystem::DispatchVariant(const EventVariant& event)
+    {
+        // std::visit compiles down to a jump table on the variant index
+        std::visit([](const auto& e)
+        {
+            if constexpr (std::is_same_v<std::decay_t<decltype(e)>, CustomEventBox>)
+                e.Dispatch();
+            else
+                IterateThroughEventListeners(e);
+        }, event);
     }
 
 }
@@ -0,0 +1,992 @@
+#include "EventSystem.hpp"
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+static int         sChecks   = 0;
+static int         sFailures = 0;
+static std::string sContext;    // printed with a failure, like the bus mode a loop is on
+
+#define CHECK(condition) Check((condition), #condition, __FILE__, __LINE__)
+
+static void Check(bool passed, const char* condition, const char* file, int line)
+{
+    sChecks++;
+
+    if (passed)
+        return;
+
+    sFailures++;
+    std::printf("    failed: %s (%s:%d) %s\n", condition, file, line, sContext.c_str());
+}
+
+// removes the listeners a test added when it's done, so the next test doesn't get its events
+class TestListeners
+{
+public:
+    ~TestListeners()
+    {
+        for (helios::ListenerHandle handle : mHandles)
+            helios::EventSystem::RemoveEventListener(handle);
+    }
+
+    void Add(helios::ListenerHandle handle) { mHandles.push_back(handle); }
+
+private:
+    std::vector<helios::ListenerHandle> mHandles;
+};
+
+// waits for a listener on another thread, gives up after a second so a bug fails the test instead of hanging it
+template<typename F>
+static bool WaitFor(F&& done)
+{
+    auto end = std::chrono::steady_clock::now() + 1s;
+
+    while (!done())
+    {
+        if (std::chrono::steady_clock::now() > end)
+            return false;
+
+        std::this_thread::sleep_for(1ms);
+    }
+
+    return true;
+}
+
+static const std::pair<helios::EventBusMode, const char*> sBusModes[] =
+{
+    { helios::BusMode_TypeSegregated, "type segregated" },
+    { helios::BusMode_Variant,        "variant"         },
+    { helios::BusMode_DoubleBuffered, "double buffered" },
+    { helios::BusMode_LockFree,       "lock-free"       },
+    { helios::BusMode_ThreadLocal,    "thread local"    },
+    { helios::BusMode_Bounded,        "bounded"         },
+};
+
+static void InitBusMode(helios::EventBusMode mode, const char* name)
+{
+    helios::EventSystemConfig config;
+    config.BusMode = mode;
+    helios::EventSystem::Init(config);
+
+    sContext = std::string("[") + name + "]";
+}
+
+//
+///////////////////////////////////////////////////////////////////////
+// Bus Modes
+///////////////////////////////////////////////////////////////////////
+//
+
+// mouse moves are recorded as their x, key presses as minus their key
+static int Record(const helios::IEvent& e)
+{
+    if (e.GetType() == helios::Type_MouseMove)
+        return static_cast<const helios::MouseMoveEvent&>(e).GetX();
+
+    return -static_cast<const helios::KeyPressEvent&>(e).GetKey();
+}
+
+static void TestOrderInEveryBusMode()
+{
+    for (const auto& [mode, name] : sBusModes)
+    {
+        InitBusMode(mode, name);
+
+        TestListeners    listeners;
+        std::vector<int> seen;
+        listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent& e) { seen.push_back(Record(e)); }));
+
+        std::vector<int> expected;
+        for (int i = 1; i <= 100; i++)
+        {
+            helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+            expected.push_back(i);
+
+            if (i % 10 == 0)
+            {
+                helios::EventSystem::AddEvent<helios::KeyPressEvent>(i);
+                expected.push_back(-i);
+            }
+        }
+
+        helios::EventSystem::Dispatch();
+        CHECK(seen == expected);
+
+        // nothing is dispatched twice
+        helios::EventSystem::Dispatch();
+        CHECK(seen.size() == expected.size());
+    }
+}
+
+// like a SIMD transform, it has to land on a 64 byte boundary wherever the bus puts it
+struct alignas(64) AlignedEvent : public helios::IEvent
+{
+    AlignedEvent(int value) : Value(value) {}
+
+    float Matrix[16] = {};
+    int   Value;
+};
+
+static void TestOverAlignedEvents()
+{
+    for (const auto& [mode, name] : sBusModes)
+    {
+        // a small frame arena, so some events come from it and the rest overflow to the heap
+        helios::EventSystemConfig config;
+        config.BusMode        = mode;
+        config.FrameArenaSize = 200;
+        helios::EventSystem::Init(config);
+        sContext = std::string("[") + name + "]";
+
+        TestListeners listeners;
+        int           misaligned = 0;
+        int           received   = 0;
+
+        listeners.Add(helios::EventSystem::Subscribe<AlignedEvent>([&](const AlignedEvent& e)
+        {
+            // volatile, or the compiler assumes it's aligned and folds the check away
+            volatile uintptr_t address = reinterpret_cast<uintptr_t>(&e);
+            if (address % alignof(AlignedEvent) != 0)
+                misaligned++;
+
+            if (e.Value == received)
+                received++;
+        }));
+
+        for (int frame = 0; frame < 2; frame++)
+        {
+            received = 0;
+
+            // a byte first, so the arena's offset isn't aligned
+            helios::EventSystem::AddEvent<helios::KeyTypeEvent>('a');
+
+            for (int i = 0; i < 8; i++)
+                helios::EventSystem::AddCustomEvent<AlignedEvent>(i);
+
+            helios::EventSystem::Dispatch();
+            CHECK(received == 8);
+        }
+
+        CHECK(misaligned == 0);
+    }
+}
+
+static void TestProducerOrderInThreadSafeModes()
+{
+    constexpr int producers = 4;
+    constexpr int events    = 20000;
+
+    for (const auto& [mode, name] : sBusModes)
+    {
+        if (mode == helios::BusMode_TypeSegregated || mode == helios::BusMode_Variant)
+            continue;
+
+        // a small ring that blocks, so the producers keep running into a full one without losing events
+        helios::EventSystemConfig config;
+        config.BusMode         = mode;
+        config.BoundedCapacity = 256;
+        config.Overflow        = helios::Overflow_Block;
+        config.ThreadRingSize  = 256;
+        helios::EventSystem::Init(config);
+        sContext = std::string("[") + name + "]";
+
+        TestListeners listeners;
+        int           last[producers] = { -1, -1, -1, -1 };
+        int           outOfOrder      = 0;
+        int           received        = 0;
+
+        listeners.Add(helios::EventSystem::Subscribe<helios::MouseMoveEvent>([&](const helios::MouseMoveEvent& e)
+        {
+            if (e.GetX() <= last[e.GetY()])
+                outOfOrder++;
+
+            last[e.GetY()] = e.GetX();
+            received++;
+        }));
+
+        std::atomic<int>         running{ producers };
+        std::vector<std::thread> threads;
+
+        for (int p = 0; p < producers; p++)
+        {
+            threads.emplace_back([&running, p]()
+            {
+                for (int i = 0; i < events; i++)
+                    helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, p));
+
+                running--;
+            });
+        }
+
+        while (running.load() != 0)
+            helios::EventSystem::Dispatch();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        helios::EventSystem::Dispatch();
+
+        CHECK(outOfOrder == 0);
+        CHECK(received == producers * events);
+    }
+}
+
+static void TestProducerThreadsThatExit()
+{
+    // a tiny ring, so most of the events spill into the overflow list before their thread exits
+    helios::EventSystemConfig config;
+    config.BusMode        = helios::BusMode_ThreadLocal;
+    config.ThreadRingSize = 16;
+    helios::EventSystem::Init(config);
+
+    TestListeners listeners;
+    int           received = 0;
+    listeners.Add(helios::EventSystem::Subscribe<helios::MouseMoveEvent>([&](const helios::MouseMoveEvent&) { received++; }));
+
+    // their rings are freed once they're drained, a ring freed too early shows up under ASan
+    for (int round = 0; round < 20; round++)
+    {
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < 4; t++)
+        {
+            threads.emplace_back([]()
+            {
+                for (int i = 0; i < 100; i++)
+                    helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+            });
+        }
+
+        if (round % 2 == 0)
+            helios::EventSystem::Dispatch();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        helios::EventSystem::Dispatch();
+    }
+
+    helios::EventSystem::Dispatch();
+    CHECK(received == 20 * 4 * 100);
+}
+
+static void TestParallelListenersInEveryBusMode()
+{
+    for (const auto& [mode, name] : sBusModes)
+    {
+        helios::EventSystemConfig config;
+        config.BusMode       = mode;
+        config.WorkerThreads = 2;
+        helios::EventSystem::Init(config);
+        sContext = std::string("[") + name + "]";
+
+        TestListeners listeners;
+        int           last[2]       = { -1, -1 };
+        int           received[2]   = { 0, 0 };
+        int           outOfOrder[2] = { 0, 0 };
+
+        // each one writes only its own counters, so they run side by side
+        for (int l = 0; l < 2; l++)
+        {
+            listeners.Add(helios::EventSystem::SubscribeParallel<helios::MouseMoveEvent>([&, l](const helios::MouseMoveEvent& e)
+            {
+                if (e.GetX() != last[l] + 1)
+                    outOfOrder[l]++;
+
+                last[l] = e.GetX();
+                received[l]++;
+            }, helios::ListenerAccess::Write(1ull << l)));
+        }
+
+        for (int frame = 0; frame < 10; frame++)
+        {
+            for (int i = 0; i < 100; i++)
+                helios::EventSystem::AddEvent(helios::MouseMoveEvent(frame * 100 + i, 0));
+
+            helios::EventSystem::Dispatch();
+        }
+
+        CHECK(received[0] == 1000 && received[1] == 1000);
+        CHECK(outOfOrder[0] == 0 && outOfOrder[1] == 0);
+    }
+}
+
+static void TestPriorityLanes()
+{
+    TestListeners    listeners;
+    std::vector<int> seen;
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent& e) { seen.push_back(Record(e)); }));
+
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(1, 0), helios::Priority_Low);
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(2, 0));
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(3, 0), helios::Priority_High);
+    helios::EventSystem::Dispatch();
+
+    CHECK((seen == std::vector<int>{ 3, 2, 1 }));
+}
+
+//
+///////////////////////////////////////////////////////////////////////
+// Listeners
+///////////////////////////////////////////////////////////////////////
+//
+
+static void TestListenerPriorityAndHandled()
+{
+    TestListeners    listeners;
+    std::vector<int> calls;
+
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent&) { calls.push_back(0); }));
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent&) { calls.push_back(5); }, 5));
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent&) { calls.push_back(1); }));
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent& e)
+    {
+        calls.push_back(10);
+
+        if (e.GetType() == helios::Type_KeyPress)
+            e.SetHandled();
+    }, 10));
+
+    // higher priorities first, the same priority in the order they were added
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(1, 1));
+    helios::EventSystem::Dispatch();
+    CHECK((calls == std::vector<int>{ 10, 5, 0, 1 }));
+
+    // nobody after the one that handled it
+    calls.clear();
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+    helios::EventSystem::Dispatch();
+    CHECK((calls == std::vector<int>{ 10 }));
+}
+
+static void TestKeyedListeners()
+{
+    TestListeners listeners;
+    int           control = 0;
+    int           any     = 0;
+    int           none    = 0;
+
+    listeners.Add(helios::EventSystem::SubscribeKey<helios::KeyPressEvent>('S', [&](const helios::KeyPressEvent&) { control++; }, helios::Modifier_Control));
+    listeners.Add(helios::EventSystem::SubscribeKey<helios::KeyPressEvent>('S', [&](const helios::KeyPressEvent&) { any++; }));
+    listeners.Add(helios::EventSystem::SubscribeKey<helios::KeyPressEvent>('S', [&](const helios::KeyPressEvent&) { none++; }, helios::Modifier_None));
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('S');
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('S', true);
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('T', true);
+    helios::EventSystem::AddEvent<helios::KeyReleaseEvent>('S');
+    helios::EventSystem::Dispatch();
+
+    CHECK(control == 1);
+    CHECK(any == 2);
+    CHECK(none == 1);
+}
+
+static void TestCategoryListeners()
+{
+    TestListeners     listeners;
+    std::vector<int>  types;
+
+    listeners.Add(helios::EventSystem::SubscribeCategory(helios::Category_Keyboard | helios::Category_MouseButton, [&](const helios::IEvent& e)
+    {
+        types.push_back(e.GetType());
+    }));
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(1, 1));
+    helios::EventSystem::AddEvent<helios::MouseButtonClickEvent>(0);
+    helios::EventSystem::AddEvent<helios::MouseScrollEvent>(1);
+    helios::EventSystem::Dispatch();
+
+    CHECK((types == std::vector<int>{ helios::Type_KeyPress, helios::Type_MouseButtonClick }));
+}
+
+static void TestChangingListenersDuringDispatch()
+{
+    TestListeners          listeners;
+    helios::ListenerHandle victim;
+    int                    victimCalls = 0;
+    int                    addedCalls  = 0;
+    int                    selfCalls   = 0;
+    helios::ListenerHandle self;
+    bool                   added       = false;
+
+    // the first event removes victim and adds another listener, the listener that removes itself only gets the first one
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent&)
+    {
+        if (added)
+            return;
+
+        added = true;
+        CHECK(helios::EventSystem::RemoveEventListener(victim));
+        listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent&) { addedCalls++; }));
+    }, 10));
+
+    victim = helios::EventSystem::AddEventListener([&](const helios::IEvent&) { victimCalls++; });
+    self   = helios::EventSystem::AddEventListener([&](const helios::IEvent&)
+    {
+        selfCalls++;
+        helios::EventSystem::RemoveEventListener(self);
+    });
+
+    for (int i = 0; i < 3; i++)
+        helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+
+    helios::EventSystem::Dispatch();
+    CHECK(victimCalls == 0);
+    CHECK(selfCalls == 1);
+    CHECK(addedCalls == 0); // it starts with the next Dispatch()
+
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(3, 0));
+    helios::EventSystem::Dispatch();
+    CHECK(victimCalls == 0);
+    CHECK(selfCalls == 1);
+    CHECK(addedCalls == 1);
+    CHECK(!helios::EventSystem::RemoveEventListener(victim));
+}
+
+static void TestChangingListenersFromOtherThreads()
+{
+    helios::EventSystemConfig config;
+    config.BusMode = helios::BusMode_LockFree;
+    helios::EventSystem::Init(config);
+
+    TestListeners     listeners;
+    int               received = 0;
+    std::atomic<bool> stop{ false };
+
+    listeners.Add(helios::EventSystem::Subscribe<helios::MouseMoveEvent>([&](const helios::MouseMoveEvent&) { received++; }));
+
+    // the registry is swapped out under Dispatch() the whole time, the listener that stays has to see every event
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; t++)
+    {
+        threads.emplace_back([&stop]()
+        {
+            while (!stop.load())
+            {
+                helios::ListenerHandle keyed = helios::EventSystem::SubscribeKey<helios::KeyPressEvent>('A', [](const helios::KeyPressEvent&) {});
+                helios::ListenerHandle any   = helios::EventSystem::AddEventListener([](const helios::IEvent&) {});
+                helios::ListenerHandle moves = helios::EventSystem::Subscribe<helios::MouseMoveEvent>([](const helios::MouseMoveEvent&) {});
+
+                helios::EventSystem::RemoveEventListener(moves);
+                helios::EventSystem::RemoveEventListener(any);
+                helios::EventSystem::RemoveEventListener(keyed);
+            }
+        });
+    }
+
+    for (int frame = 0; frame < 200; frame++)
+    {
+        for (int i = 0; i < 50; i++)
+        {
+            helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+            helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+        }
+
+        helios::EventSystem::Dispatch();
+    }
+
+    stop = true;
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    CHECK(received == 200 * 50);
+}
+
+//
+///////////////////////////////////////////////////////////////////////
+// Bounded Bus
+///////////////////////////////////////////////////////////////////////
+//
+
+// fills a ring of 4 with key presses 1 to 4, then adds the events in more
+static std::vector<int> Overflow(helios::OverflowPolicy policy, const std::vector<int>& more)
+{
+    helios::EventSystemConfig config;
+    config.BusMode         = helios::BusMode_Bounded;
+    config.BoundedCapacity = 4;
+    config.Overflow        = policy;
+    helios::EventSystem::Init(config);
+
+    TestListeners    listeners;
+    std::vector<int> seen;
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent& e) { seen.push_back(Record(e)); }));
+
+    for (int key = 1; key <= 4; key++)
+        helios::EventSystem::AddEvent<helios::KeyPressEvent>(key);
+
+    // positive numbers are mouse moves, negative ones key presses
+    for (int e : more)
+    {
+        if (e > 0)
+            helios::EventSystem::AddEvent(helios::MouseMoveEvent(e, 0));
+        else
+            helios::EventSystem::AddEvent<helios::KeyPressEvent>(-e);
+    }
+
+    helios::EventSystem::Dispatch();
+    return seen;
+}
+
+static void TestOverflowPolicies()
+{
+    sContext = "[drop oldest]";
+    CHECK((Overflow(helios::Overflow_DropOldest, { -5, -6 }) == std::vector<int>{ -3, -4, -5, -6 }));
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_KeyPress) == 2);
+
+    sContext = "[drop newest]";
+    CHECK((Overflow(helios::Overflow_DropNewest, { -5, 7 }) == std::vector<int>{ -1, -2, -3, -4 }));
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_KeyPress) == 1);
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_MouseMove) == 1);
+
+    // the latest key press takes the new one's value, a mouse move has nothing to overwrite
+    sContext = "[coalesce by type]";
+    CHECK((Overflow(helios::Overflow_CoalesceByType, { -5, 7, -6 }) == std::vector<int>{ -1, -2, -3, -6 }));
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_KeyPress) == 2);
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_MouseMove) == 1);
+}
+
+static void OverflowBlock(size_t capacity)
+{
+    helios::EventSystemConfig config;
+    config.BusMode         = helios::BusMode_Bounded;
+    config.BoundedCapacity = capacity;
+    config.Overflow        = helios::Overflow_Block;
+    helios::EventSystem::Init(config);
+
+    TestListeners    listeners;
+    std::vector<int> seen;
+    listeners.Add(helios::EventSystem::AddEventListener([&](const helios::IEvent& e) { seen.push_back(Record(e)); }));
+
+    std::atomic<bool> done{ false };
+    std::thread producer([&done]()
+    {
+        for (int i = 1; i <= 100; i++)
+            helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+
+        done = true;
+    });
+
+    while (!done.load())
+        helios::EventSystem::Dispatch();
+
+    producer.join();
+    helios::EventSystem::Dispatch();
+
+    std::vector<int> expected;
+    for (int i = 1; i <= 100; i++)
+        expected.push_back(i);
+
+    CHECK(seen == expected);
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_MouseMove) == 0);
+}
+
+static void TestOverflowBlockFromParallelListeners()
+{
+    helios::EventSystemConfig config;
+    config.BusMode         = helios::BusMode_Bounded;
+    config.BoundedCapacity = 4;
+    config.Overflow        = helios::Overflow_Block;
+    config.WorkerThreads   = 3;
+    helios::EventSystem::Init(config);
+
+    TestListeners listeners;
+
+    // each one adds more than the ring has room for while Dispatch() waits for them, so they have to drop instead of waiting
+    for (uint64_t bit = 0; bit < 4; bit++)
+    {
+        listeners.Add(helios::EventSystem::SubscribeParallel<helios::KeyPressEvent>([](const helios::KeyPressEvent&)
+        {
+            // slow enough that the job system threads get some of them, not just the one calling Dispatch()
+            std::this_thread::sleep_for(5ms);
+
+            for (int i = 0; i < 3; i++)
+                helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+        }, helios::ListenerAccess::Write(1ull << bit)));
+    }
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+
+    std::atomic<bool> done{ false };
+    std::thread dispatcher([&done]()
+    {
+        helios::EventSystem::Dispatch();
+        done = true;
+    });
+
+    // a deadlock can't be recovered from, so stop here instead of hanging
+    if (!WaitFor([&] { return done.load(); }))
+    {
+        std::printf("    failed: Dispatch() deadlocked with parallel listeners adding to a full Overflow_Block ring\n");
+        std::fflush(stdout);
+        std::_Exit(1);
+    }
+
+    dispatcher.join();
+    helios::EventSystem::Dispatch();
+
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_MouseMove) == 4 * 3 - 4);
+}
+
+static void TestOverflowBlockWaitsForDispatch()
+{
+    for (size_t capacity : { 4, 0 }) // a capacity of 0 is raised to 1
+    {
+        sContext = "[capacity " + std::to_string(capacity) + "]";
+        OverflowBlock(capacity);
+    }
+}
+
+//
+///////////////////////////////////////////////////////////////////////
+// Timers
+///////////////////////////////////////////////////////////////////////
+//
+
+static void TestDelayedEvents()
+{
+    TestListeners listeners;
+    int           keys = 0;
+    listeners.Add(helios::EventSystem::Subscribe<helios::KeyPressEvent>([&](const helios::KeyPressEvent&) { keys++; }));
+
+    helios::EventSystem::AddEventAfter(helios::KeyPressEvent('A'), 20ms);
+    helios::EventSystem::AddEventAt(helios::KeyPressEvent('B'), helios::TimerClock::now() - 1s);
+
+    // one that's already due goes out with the first Dispatch() a tick later
+    std::this_thread::sleep_for(2ms);
+    helios::EventSystem::Dispatch();
+    CHECK(keys == 1);
+
+    std::this_thread::sleep_for(40ms);
+    helios::EventSystem::Dispatch();
+    CHECK(keys == 2);
+
+    helios::TimerHandle cancelled = helios::EventSystem::AddEventAfter(helios::KeyPressEvent('C'), 1ms);
+    CHECK(helios::EventSystem::CancelTimer(cancelled));
+    CHECK(!helios::EventSystem::CancelTimer(cancelled));
+
+    std::this_thread::sleep_for(10ms);
+    helios::EventSystem::Dispatch();
+    CHECK(keys == 2);
+}
+
+static void TestPeriodicEvents()
+{
+    TestListeners listeners;
+    int           ticks = 0;
+    listeners.Add(helios::EventSystem::Subscribe<helios::KeyPressEvent>([&](const helios::KeyPressEvent&) { ticks++; }));
+
+    helios::TimerHandle timer = helios::EventSystem::AddEventAfter(helios::KeyPressEvent('T'), 2ms, 2ms);
+
+    auto end = helios::TimerClock::now() + 50ms;
+    while (helios::TimerClock::now() < end)
+        helios::EventSystem::Dispatch();
+
+    CHECK(ticks >= 5);
+    CHECK(helios::EventSystem::CancelTimer(timer));
+
+    int stopped = ticks;
+    std::this_thread::sleep_for(10ms);
+    helios::EventSystem::Dispatch();
+    CHECK(ticks == stopped);
+}
+
+static void TestZeroTimerResolution()
+{
+    helios::EventSystemConfig config;
+    config.TimerResolution = helios::TimerClock::duration::zero();
+    helios::EventSystem::Init(config);
+
+    TestListeners listeners;
+    int           keys = 0;
+    listeners.Add(helios::EventSystem::Subscribe<helios::KeyPressEvent>([&](const helios::KeyPressEvent&) { keys++; }));
+
+    helios::EventSystem::AddEventAfter(helios::KeyPressEvent('A'), 1ms);
+    std::this_thread::sleep_for(5ms);
+    helios::EventSystem::Dispatch();
+
+    CHECK(keys == 1);
+}
+
+static void TestTimersKeepTheirTimeAcrossInit()
+{
+    TestListeners listeners;
+    int           keys = 0;
+    listeners.Add(helios::EventSystem::Subscribe<helios::KeyPressEvent>([&](const helios::KeyPressEvent&) { keys++; }));
+
+    helios::EventSystem::AddEventAfter(helios::KeyPressEvent('A'), 30ms);
+
+    helios::EventSystemConfig config;
+    config.TimerResolution = 100us;
+    helios::EventSystem::Init(config);
+
+    std::this_thread::sleep_for(5ms);
+    helios::EventSystem::Dispatch();
+    CHECK(keys == 0);
+
+    std::this_thread::sleep_for(40ms);
+    helios::EventSystem::Dispatch();
+    CHECK(keys == 1);
+}
+
+static void TestTimerIntoFullBlockingRing()
+{
+    helios::EventSystemConfig config;
+    config.BusMode         = helios::BusMode_Bounded;
+    config.BoundedCapacity = 1;
+    config.Overflow        = helios::Overflow_Block;
+    helios::EventSystem::Init(config);
+
+    TestListeners listeners;
+    int           keys = 0;
+    listeners.Add(helios::EventSystem::Subscribe<helios::KeyPressEvent>([&](const helios::KeyPressEvent&) { keys++; }));
+
+    // Dispatch() fires the timer into the full ring, it has to drop it instead of waiting for itself
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+    helios::EventSystem::AddEventAfter(helios::KeyPressEvent('T'), 0ms);
+    std::this_thread::sleep_for(5ms);
+    helios::EventSystem::Dispatch();
+
+    CHECK(keys == 1);
+    CHECK(helios::EventSystem::GetDroppedEventCount(helios::Type_KeyPress) == 1);
+}
+
+//
+///////////////////////////////////////////////////////////////////////
+// Executors
+///////////////////////////////////////////////////////////////////////
+//
+
+static void TestExecutorsKeepOrder()
+{
+    const std::pair<helios::ListenerExecutor, const char*> executors[] =
+    {
+        { helios::Executor_Inline,     "inline"      },
+        { helios::Executor_MainThread, "main thread" },
+        { helios::Executor_Worker,     "worker"      },
+        { helios::Executor_Dedicated,  "dedicated"   },
+    };
+
+    for (const auto& [executor, name] : executors)
+    {
+        sContext = std::string("[") + name + "]";
+
+        TestListeners     listeners;
+        std::vector<int>  seen;
+        std::atomic<int>  count{ 0 };
+
+        listeners.Add(helios::EventSystem::SubscribeOn<helios::MouseMoveEvent>(executor, [&](const helios::MouseMoveEvent& e)
+        {
+            seen.push_back(e.GetX());
+            count++;
+        }));
+
+        std::vector<int> expected;
+        for (int i = 0; i < 100; i++)
+        {
+            helios::EventSystem::AddEvent(helios::MouseMoveEvent(i, 0));
+            expected.push_back(i);
+        }
+
+        helios::EventSystem::Dispatch();
+
+        if (executor == helios::Executor_MainThread)
+            CHECK(helios::EventSystem::PumpMainThread() == 100);
+
+        CHECK(WaitFor([&] { return count.load() == 100; }));
+        CHECK(seen == expected);
+    }
+}
+
+static void TestDedicatedListenerRemovesItself()
+{
+    std::atomic<int>       count{ 0 };
+    helios::ListenerHandle handle;
+    std::atomic<bool>      dispatched{ false };
+
+    // removing itself used to join its own thread and abort
+    // it waits for Dispatch() to post both events, so they're both posted before it's removed
+    handle = helios::EventSystem::SubscribeOn<helios::KeyPressEvent>(helios::Executor_Dedicated, [&](const helios::KeyPressEvent&)
+    {
+        while (!dispatched.load())
+            std::this_thread::yield();
+
+        if (count++ == 0)
+            CHECK(helios::EventSystem::RemoveEventListener(handle));
+    });
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('B');
+    helios::EventSystem::Dispatch();
+    dispatched = true;
+
+    // both were posted before the removal, so both are delivered
+    CHECK(WaitFor([&] { return count.load() == 2; }));
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('C');
+    helios::EventSystem::Dispatch();
+    std::this_thread::sleep_for(10ms);
+    CHECK(count.load() == 2);
+}
+
+static void TestRemovingASlowDedicatedListenerDoesntWait()
+{
+    std::atomic<int> count{ 0 };
+
+    helios::ListenerHandle handle = helios::EventSystem::SubscribeOn<helios::KeyPressEvent>(helios::Executor_Dedicated, [&](const helios::KeyPressEvent&)
+    {
+        std::this_thread::sleep_for(20ms);
+        count++;
+    });
+
+    for (int i = 0; i < 10; i++)
+        helios::EventSystem::AddEvent<helios::KeyPressEvent>(i);
+
+    helios::EventSystem::Dispatch();
+
+    auto start = std::chrono::steady_clock::now();
+    CHECK(helios::EventSystem::RemoveEventListener(handle));
+    helios::EventSystem::Dispatch();
+    CHECK(std::chrono::steady_clock::now() - start < 100ms);
+
+    // the backlog is still delivered
+    CHECK(WaitFor([&] { return count.load() == 10; }));
+}
+
+#ifdef HELIOS_COROUTINES
+//
+///////////////////////////////////////////////////////////////////////
+// Coroutines
+///////////////////////////////////////////////////////////////////////
+//
+
+static helios::EventTask WaitForKeys(std::vector<int>& keys, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const helios::KeyPressEvent& e = co_await helios::NextEvent<helios::KeyPressEvent>();
+        keys.push_back(e.GetKey());
+    }
+}
+
+static void TestCoroutineWaitsForEvents()
+{
+    std::vector<int>  keys;
+    helios::EventTask task = WaitForKeys(keys, 2);
+    CHECK(!task.IsDone());
+
+    // a mouse move doesn't wake it up
+    helios::EventSystem::AddEvent(helios::MouseMoveEvent(1, 1));
+    helios::EventSystem::Dispatch();
+    CHECK(keys.empty());
+
+    // it's resumed once per event, even with both in one Dispatch()
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('B');
+    helios::EventSystem::Dispatch();
+    CHECK((keys == std::vector<int>{ 'A', 'B' }));
+    CHECK(task.IsDone());
+}
+
+static void TestHandledEventsSkipCoroutines()
+{
+    TestListeners listeners;
+    listeners.Add(helios::EventSystem::Subscribe<helios::KeyPressEvent>([](const helios::KeyPressEvent& e)
+    {
+        if (e.GetKey() == 'X')
+            e.SetHandled();
+    }));
+
+    std::vector<int>  keys;
+    helios::EventTask task = WaitForKeys(keys, 1);
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('X');
+    helios::EventSystem::Dispatch();
+    CHECK(keys.empty());
+
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('Y');
+    helios::EventSystem::Dispatch();
+    CHECK((keys == std::vector<int>{ 'Y' }));
+}
+
+static void TestDestroyedAndDetachedTasks()
+{
+    std::vector<int> destroyedKeys;
+    std::vector<int> detachedKeys;
+
+    {
+        helios::EventTask destroyed = WaitForKeys(destroyedKeys, 1);
+    }
+
+    WaitForKeys(detachedKeys, 1).Detach();
+
+    // the destroyed one stopped waiting, the detached one runs to the end and frees itself (ASan tells if it doesn't)
+    helios::EventSystem::AddEvent<helios::KeyPressEvent>('A');
+    helios::EventSystem::Dispatch();
+    CHECK(destroyedKeys.empty());
+    CHECK((detachedKeys == std::vector<int>{ 'A' }));
+}
+#endif
+
+//
+///////////////////////////////////////////////////////////////////////
+// Main
+///////////////////////////////////////////////////////////////////////
+//
+
+static void RunTest(const char* name, void (*test)())
+{
+    // every test starts with the default config and an empty bus
+    helios::EventSystem::Init();
+    sContext.clear();
+
+    int failures = sFailures;
+    test();
+
+    std::printf("%s %s\n", sFailures == failures ? "[ ok ]" : "[FAIL]", name);
+}
+
+int main()
+{
+    RunTest("events keep their order in every bus mode",            TestOrderInEveryBusMode);
+    RunTest("over-aligned events are aligned in every bus mode",    TestOverAlignedEvents);
+    RunTest("events from one thread keep their order",              TestProducerOrderInThreadSafeModes);
+    RunTest("events from threads that have exited are dispatched",  TestProducerThreadsThatExit);
+    RunTest("parallel listeners get every event in order",          TestParallelListenersInEveryBusMode);
+    RunTest("higher priority lanes are dispatched first",           TestPriorityLanes);
+    RunTest("listeners go by priority and stop at a handled event", TestListenerPriorityAndHandled);
+    RunTest("key listeners only get their key and modifiers",       TestKeyedListeners);
+    RunTest("category listeners only get their categories",         TestCategoryListeners);
+    RunTest("listeners added and removed during Dispatch()",        TestChangingListenersDuringDispatch);
+    RunTest("listeners added and removed from other threads",       TestChangingListenersFromOtherThreads);
+    RunTest("overflow policies drop and coalesce the right events", TestOverflowPolicies);
+    RunTest("Overflow_Block waits for Dispatch() to make room",     TestOverflowBlockWaitsForDispatch);
+    RunTest("parallel listeners don't wait for a full ring",        TestOverflowBlockFromParallelListeners);
+    RunTest("delayed events fire once they're due",                 TestDelayedEvents);
+    RunTest("periodic events fire until they're cancelled",         TestPeriodicEvents);
+    RunTest("a zero timer resolution is clamped to a clock tick",   TestZeroTimerResolution);
+    RunTest("pending timers keep their time across Init()",        TestTimersKeepTheirTimeAcrossInit);
+    RunTest("a timer firing into a full blocking ring is dropped",  TestTimerIntoFullBlockingRing);
+    RunTest("executor listeners get their events in order",         TestExecutorsKeepOrder);
+    RunTest("a dedicated listener can remove itself",               TestDedicatedListenerRemovesItself);
+    RunTest("removing a slow dedicated listener doesn't wait",      TestRemovingASlowDedicatedListenerDoesntWait);
+
+#ifdef HELIOS_COROUTINES
+    RunTest("coroutines wait for the events they co_await",         TestCoroutineWaitsForEvents);
+    RunTest("coroutines skip events a listener handled",            TestHandledEventsSkipCoroutines);
+    RunTest("destroyed tasks stop waiting, detached ones finish",   TestDestroyedAndDetachedTasks);
+#endif
+
+    helios::EventSystem::Init();
+
+    std::printf("\n%d checks, %d failed\n", sChecks, sFailures);
+    return sFailures == 0 ? 0 : 1;
+}
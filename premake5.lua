@@ -85,4 +85,90 @@ workspace "Helios"
         filter "configurations:Release"
             defines "RELEASE"
             runtime "Release"
-            optimize "On"
\ No newline at end of file
+            optimize "On"
+    project "Benchmarks"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++17"
+        staticruntime "On"
+        location "Benchmarks"
+    
+        targetdir ("bin/"     .. outputdir .. "/%{prj.name}")
+        objdir    ("bin-int/" .. outputdir .. "/%{prj.name}")
+    
+        disablewarnings { warnings }
+    
+        files
+        {
+            "Benchmarks/**.hpp",
+            "Benchmarks/**.cpp",
+        }
+    
+        includedirs
+        {
+            "Source",
+        }
+    
+        links
+        {
+            "HeliosEventSystem"
+        }
+    
+        filter "system:windows"
+            systemversion "latest"
+
+        filter "system:linux"
+            links { "pthread" }
+    
+        filter "configurations:Debug"
+            defines "DEBUG"
+            runtime "Debug"
+            symbols "On"
+    
+        filter "configurations:Release"
+            defines "RELEASE"
+            runtime "Release"
+            optimize "On"
+    project "Tests"
+        kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++20"    -- so the coroutine tests are built too
+        staticruntime "On"
+        location "Tests"
+    
+        targetdir ("bin/"     .. outputdir .. "/%{prj.name}")
+        objdir    ("bin-int/" .. outputdir .. "/%{prj.name}")
+    
+        disablewarnings { warnings }
+    
+        files
+        {
+            "Tests/**.hpp",
+            "Tests/**.cpp",
+        }
+    
+        includedirs
+        {
+            "Source",
+        }
+    
+        links
+        {
+            "HeliosEventSystem"
+        }
+    
+        filter "system:windows"
+            systemversion "latest"
+
+        filter "system:linux"
+            links { "pthread" }
+    
+        filter "configurations:Debug"
+            defines "DEBUG"
+            runtime "Debug"
+            symbols "On"
+    
+        filter "configurations:Release"
+            defines "RELEASE"
+            runtime "Release"
+            optimize "On"